@@ -8,8 +8,43 @@
 #include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include <string>
+#include <random>
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-template <typename T>
+/*
+ *  Locked：默认模式，互斥锁 + 条件变量，任意多个线程 push/pop，满/空时阻塞
+ *  SPSC：  只有一个生产者线程和一个消费者线程，无锁、无等待
+ *  Bip：   单生产者单消费者的字节流，按连续区域直接读写（bip-buffer），不逐个拷贝
+ *  Mirrored：同一组物理页映射两遍（仅 Linux），任意长度的可读/可写范围都连续
+ *  Overwrite：满了覆盖最旧的记录，写入方永不等待，用作进程内的飞行记录器/trace 缓冲
+ */
+enum class BufferMode{
+    Locked,
+    SPSC,
+    Bip,
+    Mirrored,
+    Overwrite
+};
+
+template <typename T, BufferMode Mode = BufferMode::Locked>
 class CircularBuffer{
 private:
     std::vector<T> buf_;
@@ -84,6 +119,502 @@ public:
     }
 };
 
+/*
+ *  单生产者单消费者模式：读写下标各自只有一个线程写，用 acquire/release 交接，不需要锁和 CAS
+ *  - 容量向上取 2 的幂，下标一直递增，取槽用掩码
+ *  - 读写下标放在不同缓存行，生产者和消费者各自缓存一份对方的下标，只有看起来满/空时才重新读对方的缓存行
+ *  - try_push/try_pop 永不阻塞；只有显式调用 push/pop 才会在满/空时等待（先自旋再 yield）
+ */
+template <typename T>
+class CircularBuffer<T, BufferMode::SPSC>{
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    static size_t round_up(size_t n){
+        size_t cap = 1;
+        while(cap < n){
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    template<typename Ready>
+    static void wait_until(Ready ready){
+        for(int spin = 0; !ready(); spin++){
+            if(spin >= 64){
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    struct Slot{
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value(){
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+public:
+    explicit CircularBuffer(size_t size)
+        : mask_(round_up(size == 0 ? 1 : size) - 1),
+          slots_(new Slot[mask_ + 1]){}
+    ~CircularBuffer(){
+        for(size_t i = head_.load(std::memory_order_relaxed); i != tail_.load(std::memory_order_relaxed); i++){
+            slots_[i & mask_].value()->~T();
+        }
+    }
+    CircularBuffer(const CircularBuffer&) = delete;
+    CircularBuffer& operator=(const CircularBuffer&) = delete;
+
+    // 生产者调用
+    template<typename... Args>
+    bool try_emplace(Args&&... args){
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail - cached_head_ > mask_){
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if(tail - cached_head_ > mask_){
+                return false;
+            }
+        }
+        new (slots_[tail & mask_].storage) T(std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_push(const T& item){
+        return try_emplace(item);
+    }
+    bool try_push(T&& item){
+        return try_emplace(std::move(item));
+    }
+    // 满时等待
+    void push(const T& item){
+        wait_until([&](){ return try_emplace(item); });
+    }
+    void push(T&& item){
+        wait_until([&](){ return try_emplace(std::move(item)); });
+    }
+
+    // 消费者调用
+    bool try_pop(T& value){
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(head == cached_tail_){
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if(head == cached_tail_){
+                return false;
+            }
+        }
+        T* item = slots_[head & mask_].value();
+        value = std::move(*item);
+        item->~T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    // 空时等待
+    T pop(){
+        T* item;
+        wait_until([&](){ return (item = front()) != nullptr; });
+        T value = std::move(*item);
+        item->~T();
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return value;
+    }
+    // 消费者查看队头，空时返回 nullptr
+    T* front(){
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(head == cached_tail_){
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if(head == cached_tail_){
+                return nullptr;
+            }
+        }
+        return slots_[head & mask_].value();
+    }
+
+    // 以下在并发时只是某一时刻的近似
+    // 先读 head_ 再读 tail_：tail_ 只增不减，读到的一定不小于 head_，不会减成一个巨大的数；
+    // 两次读之间生产者可能又写了几个，结果截到容量为止
+    size_t size() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return std::min(tail - head, mask_ + 1);
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    bool full() const {
+        return size() > mask_;
+    }
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(CACHE_LINE) std::atomic<size_t> head_{0}; // 消费者写
+    size_t cached_tail_ = 0;                          // 消费者缓存的 tail_
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{0}; // 生产者写
+    size_t cached_head_ = 0;                          // 生产者缓存的 head_
+    char pad_[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+/*
+ *  bip-buffer：生产者 write_region(n) 拿到一段连续可写区域，直接 recv()/memcpy 进去，再 commit 实际写入的长度；
+ *  消费者 read_region() 拿到一段连续可读区域原地解析，再 consume 用掉的长度。
+ *  尾部放不下 n 个时从头开始写，并用 watermark 记下旧数据的结尾，所以一段区域永远不会被回绕拆开，代价是尾部那点空间暂时不用。
+ *  只允许一个生产者线程和一个消费者线程，read_/write_/watermark_ 用 acquire/release 交接
+ */
+template <typename T>
+class CircularBuffer<T, BufferMode::Bip>{
+    static_assert(std::is_trivially_copyable<T>::value, "Bip mode is for trivially copyable elements such as bytes");
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+public:
+    struct Region{
+        T* data = nullptr;
+        size_t size = 0;
+
+        T* begin() const { return data; }
+        T* end() const { return data + size; }
+        bool empty() const { return size == 0; }
+    };
+
+    explicit CircularBuffer(size_t size)
+        : size_(size),
+          buf_(new T[size]){}
+    CircularBuffer(const CircularBuffer&) = delete;
+    CircularBuffer& operator=(const CircularBuffer&) = delete;
+
+    // 生产者：申请 n 个连续元素，空间不够返回空区域；commit 之前再次申请会覆盖上一次
+    Region write_region(size_t n){
+        size_t w = write_.load(std::memory_order_relaxed);
+        size_t r = read_.load(std::memory_order_acquire);
+        if(n == 0){
+            return Region{};
+        }
+        if(w >= r){
+            if(size_ - w >= n){
+                return reserve(w, n, false);
+            }
+            // 尾部不够，从头开始；写完不能追上 read_，否则和“空”分不清
+            if(r > n){
+                return reserve(0, n, true);
+            }
+            return Region{};
+        }
+        if(r - w > n){
+            return reserve(w, n, false);
+        }
+        return Region{};
+    }
+
+    // 生产者：发布 write_region 里前 n 个元素
+    void commit(size_t n){
+        if(n > reserved_){
+            throw std::invalid_argument("commit more than reserved");
+        }
+        reserved_ = 0;
+        if(n == 0){
+            return;
+        }
+        if(wrap_){
+            // 先记下旧数据的结尾，再让 write_ 回绕，消费者看到回绕时一定能看到 watermark
+            watermark_.store(write_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            write_.store(n, std::memory_order_release);
+        }
+        else{
+            write_.store(write_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        }
+    }
+
+    // 消费者：当前可以连续读的全部元素，空时返回空区域
+    Region read_region(){
+        size_t r = read_.load(std::memory_order_relaxed);
+        size_t w = write_.load(std::memory_order_acquire);
+        if(w >= r){
+            return Region{buf_.get() + r, w - r};
+        }
+        // 生产者已经回绕：先读到 watermark，读完再从头读
+        size_t mark = watermark_.load(std::memory_order_relaxed);
+        if(r == mark){
+            read_.store(0, std::memory_order_release);
+            return Region{buf_.get(), w};
+        }
+        return Region{buf_.get() + r, mark - r};
+    }
+
+    // 消费者：用掉 read_region 开头的 n 个元素
+    void consume(size_t n){
+        read_.store(read_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // 并发时只是近似
+    size_t size() const {
+        size_t r = read_.load(std::memory_order_acquire);
+        size_t w = write_.load(std::memory_order_acquire);
+        return w >= r ? w - r : watermark_.load(std::memory_order_relaxed) - r + w;
+    }
+    bool empty() const {
+        return read_.load(std::memory_order_acquire) == write_.load(std::memory_order_acquire);
+    }
+    size_t capacity() const {
+        return size_;
+    }
+
+private:
+    Region reserve(size_t start, size_t n, bool wrap){
+        reserved_ = n;
+        wrap_ = wrap;
+        return Region{buf_.get() + start, n};
+    }
+
+    const size_t size_;
+    std::unique_ptr<T[]> buf_;
+    alignas(CACHE_LINE) std::atomic<size_t> read_{0};   // 消费者写
+    alignas(CACHE_LINE) std::atomic<size_t> write_{0};  // 生产者写
+    std::atomic<size_t> watermark_{0};                  // 回绕前旧数据的结尾，生产者写
+    size_t reserved_ = 0;                               // 以下只有生产者访问
+    bool wrap_ = false;
+};
+
+#ifdef __linux__
+/*
+ *  镜像环：memfd_create 建一段共享内存，在连续的虚拟地址上映射两遍，buf[i] 和 buf[i + size] 是同一个字节。
+ *  所以从任意位置开始、不超过容量的范围在虚拟地址上都是连续的，读写都不用处理回绕，也不用像 Bip 那样浪费尾部。
+ *  适合大的字节环：可读部分整段交给 send()/write() 或解析器，可写部分整段交给 recv()/read()。
+ *  容量向上取到页大小的 2 的幂倍；单生产者单消费者，下标和 SPSC 模式一样一直递增，用掩码取位置
+ */
+template <typename T>
+class CircularBuffer<T, BufferMode::Mirrored>{
+    static_assert(std::is_trivially_copyable<T>::value, "Mirrored mode is for trivially copyable elements such as bytes");
+    static_assert((sizeof(T) & (sizeof(T) - 1)) == 0, "element size must be a power of two");
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+public:
+    using Region = typename CircularBuffer<T, BufferMode::Bip>::Region;
+
+    explicit CircularBuffer(size_t size){
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t bytes = page;
+        while(bytes < size * sizeof(T)){
+            bytes <<= 1;
+        }
+        int fd = ::memfd_create("CircularBuffer", MFD_CLOEXEC);
+        if(fd < 0){
+            throw std::runtime_error("CircularBuffer: memfd_create failed");
+        }
+        if(::ftruncate(fd, static_cast<off_t>(bytes)) != 0){
+            ::close(fd);
+            throw std::runtime_error("CircularBuffer: ftruncate failed");
+        }
+        // 先占住 2 倍大小的地址空间，再把同一个文件固定映射到前后两半
+        void* base = ::mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        bool ok = base != MAP_FAILED;
+        if(ok){
+            char* p = static_cast<char*>(base);
+            ok = ::mmap(p, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+                 && ::mmap(p + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+            if(!ok){
+                ::munmap(base, 2 * bytes);
+            }
+        }
+        ::close(fd); // 映射还在，文件描述符不再需要
+        if(!ok){
+            throw std::runtime_error("CircularBuffer: mmap failed");
+        }
+        bytes_ = bytes;
+        mask_ = bytes / sizeof(T) - 1;
+        buf_ = static_cast<T*>(base);
+    }
+    ~CircularBuffer(){
+        ::munmap(buf_, 2 * bytes_);
+    }
+    CircularBuffer(const CircularBuffer&) = delete;
+    CircularBuffer& operator=(const CircularBuffer&) = delete;
+
+    // 生产者：全部空闲空间，连续
+    Region write_region(){
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        return Region{buf_ + (tail & mask_), capacity() - (tail - head)};
+    }
+    // 生产者：和 Bip 模式一样申请 n 个，空闲不够返回空区域
+    Region write_region(size_t n){
+        Region region = write_region();
+        return region.size >= n ? Region{region.data, n} : Region{};
+    }
+    // 生产者：发布 write_region 开头的 n 个元素
+    void commit(size_t n){
+        tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // 消费者：全部可读数据，连续
+    Region read_region(){
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return Region{buf_ + (head & mask_), tail - head};
+    }
+    // 消费者：用掉 read_region 开头的 n 个元素
+    void consume(size_t n){
+        head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // 并发时只是近似；和 SPSC 模式一样先读 head_ 再读 tail_，结果截到容量
+    size_t size() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return std::min(tail - head, mask_ + 1);
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    T* buf_ = nullptr;
+    size_t bytes_ = 0;
+    size_t mask_ = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> head_{0}; // 消费者写
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{0}; // 生产者写
+};
+#endif
+
+/*
+ *  覆盖模式（飞行记录器）：一个写入线程，满了直接覆盖最旧的，push 没有锁、没有 CAS，写入方无等待。
+ *  多个线程要记录时每个线程一个缓冲区，比多个写入方抢同一个槽便宜，也避免写入方互相覆盖写了一半的记录。
+ *  每个槽带一个序号，按 seqlock 方式读：写之前标成“正在写”，写完标成 2 * (位置 + 1)，
+ *  读的前后序号一致且等于期望值，才说明读到的是完整的这一条，没被并发覆盖。
+ *  - snapshot()：任意线程随时拷出最近的一段连续记录，不阻塞写入方，也不消费
+ *  - try_pop()：一个消费者按顺序取；被覆盖掉没来得及取的条数计入 dropped()
+ *  记录按 8 字节原子字存放，所以 T 必须可平凡拷贝
+ */
+template <typename T>
+class CircularBuffer<T, BufferMode::Overwrite>{
+    static_assert(std::is_trivially_copyable<T>::value, "Overwrite mode is for trivially copyable records");
+private:
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    struct Slot{
+        std::atomic<uint64_t> seq{0};  // 奇数：正在写；2 * (pos + 1)：第 pos 条已写完
+        std::atomic<uint64_t> words[WORDS];
+    };
+
+    static size_t round_up(size_t n){
+        size_t cap = 1;
+        while(cap < n){
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+public:
+    explicit CircularBuffer(size_t size)
+        : mask_(round_up(size == 0 ? 1 : size) - 1),
+          slots_(new Slot[mask_ + 1]){}
+    CircularBuffer(const CircularBuffer&) = delete;
+    CircularBuffer& operator=(const CircularBuffer&) = delete;
+
+    // 写入方：无等待，满了覆盖最旧的记录
+    void push(const T& item){
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[pos & mask_];
+        uint64_t raw[WORDS] = {};
+        std::memcpy(raw, &item, sizeof(T));
+        slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i = 0; i < WORDS; i++){
+            slot.words[i].store(raw[i], std::memory_order_relaxed);
+        }
+        slot.seq.store(2 * (pos + 1), std::memory_order_release);
+        head_.store(pos + 1, std::memory_order_release);
+    }
+
+    /*
+     *  拷出最近的最多 max_count 条连续记录，从旧到新。
+     *  从最新往回读，遇到第一条被覆盖（或正在被覆盖）的就停，保证结果是连续的一段。
+     *  记录先拷到对齐的原始缓冲区再从那里拷贝构造，T 不需要默认构造
+     */
+    std::vector<T> snapshot(size_t max_count = SIZE_MAX) const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t count = std::min<uint64_t>({head, mask_ + 1, max_count});
+        std::vector<T> newest_first;
+        newest_first.reserve(count);
+        for(uint64_t pos = head; pos-- > head - count;){
+            alignas(T) unsigned char storage[sizeof(T)];
+            if(!read(pos, storage)){
+                break;
+            }
+            newest_first.push_back(*std::launder(reinterpret_cast<const T*>(storage)));
+        }
+        return std::vector<T>(newest_first.rbegin(), newest_first.rend());
+    }
+
+    // 单个消费者按顺序取，没有新记录返回 false；已经被覆盖的跳过并计入 dropped()
+    bool try_pop(T& value){
+        while(true){
+            uint64_t head = head_.load(std::memory_order_acquire);
+            if(tail_ == head){
+                return false;
+            }
+            if(head - tail_ > mask_ + 1){
+                dropped_.fetch_add(head - tail_ - (mask_ + 1), std::memory_order_relaxed);
+                tail_ = head - (mask_ + 1);
+            }
+            if(read(tail_, &value)){
+                tail_++;
+                return true;
+            }
+            // 读的过程中被新一圈覆盖了
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            tail_++;
+        }
+    }
+
+    // 消费者没来得及取就被覆盖的条数
+    uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+    // 总共写入的条数
+    uint64_t written() const {
+        return head_.load(std::memory_order_relaxed);
+    }
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    // seqlock 读：前后两次序号都等于第 pos 条写完的值才算读到，记录按字节拷到 out（至少 sizeof(T) 字节）
+    bool read(uint64_t pos, void* out) const {
+        const Slot& slot = slots_[pos & mask_];
+        uint64_t expect = 2 * (pos + 1);
+        if(slot.seq.load(std::memory_order_acquire) != expect){
+            return false;
+        }
+        uint64_t raw[WORDS];
+        for(size_t i = 0; i < WORDS; i++){
+            raw[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.seq.load(std::memory_order_relaxed) != expect){
+            return false;
+        }
+        std::memcpy(out, raw, sizeof(T));
+        return true;
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(CACHE_LINE) std::atomic<uint64_t> head_{0};    // 只有写入方修改
+    alignas(CACHE_LINE) uint64_t tail_ = 0;                // 只有消费者访问
+    std::atomic<uint64_t> dropped_{0};
+};
+
 
 namespace CircularBuffer_Test{
     void test()
@@ -110,6 +641,447 @@ namespace CircularBuffer_Test{
         cb.clear();
         std::cout << "After clear, size: " << cb.size() << std::endl;
     }
+
+    // SPSC：只能移动的类型，满/空判断，跨线程按顺序交接
+    void spsc_test(){
+        std::cout << "=== CircularBuffer SPSC Test ===" << std::endl;
+        CircularBuffer<std::unique_ptr<int>, BufferMode::SPSC> small(3);
+        int pushed = 0;
+        while(small.try_push(std::make_unique<int>(pushed))){
+            pushed++;
+        }
+        std::cout << "capacity " << small.capacity() << ", pushed until full " << pushed << " (expect 4, 4)" << std::endl;
+        std::unique_ptr<int> out;
+        std::cout << "pop order:";
+        while(small.try_pop(out)){
+            std::cout << " " << *out;
+        }
+        std::cout << " (expect 0 1 2 3)" << std::endl;
+
+        const uint64_t n = 1000000;
+        CircularBuffer<uint64_t, BufferMode::SPSC> cb(1024);
+        std::thread producer([&cb, n](){
+            for(uint64_t i = 0; i < n; i++){
+                cb.push(i);
+            }
+        });
+        // 第三个线程随时查 size()，不能超过容量
+        std::atomic<bool> observing{true};
+        uint64_t bad_sizes = 0;
+        std::thread observer([&cb, &observing, &bad_sizes](){
+            while(observing.load(std::memory_order_relaxed)){
+                bad_sizes += cb.size() > cb.capacity();
+            }
+        });
+        uint64_t mismatches = 0;
+        for(uint64_t i = 0; i < n; i++){
+            mismatches += cb.pop() != i;
+        }
+        producer.join();
+        observing = false;
+        observer.join();
+        std::cout << "mismatches: " << mismatches << ", size() over capacity: " << bad_sizes << " (expect 0, 0)" << std::endl;
+    }
+
+    /*
+     *  Bip 模式：生产者写长度前缀的变长消息，消费者原地解析。
+     *  缓冲区只有 1000 字节，消息 1~200 字节，不断回绕，每条消息都必须完整地出现在同一个区域里
+     */
+    void bip_test(){
+        std::cout << "=== CircularBuffer Bip Test ===" << std::endl;
+        CircularBuffer<char, BufferMode::Bip> cb(1000);
+        const int messages = 200000;
+        std::thread producer([&cb, messages](){
+            for(int i = 0; i < messages; i++){
+                uint32_t len = 1 + i % 200;
+                size_t total = sizeof(uint32_t) + len;
+                CircularBuffer<char, BufferMode::Bip>::Region region;
+                while((region = cb.write_region(total)).empty()){
+                    std::this_thread::yield();
+                }
+                std::memcpy(region.data, &len, sizeof(len));
+                std::memset(region.data + sizeof(len), 'a' + i % 26, len);
+                cb.commit(total);
+            }
+        });
+        int received = 0;
+        int corrupted = 0;
+        while(received < messages){
+            auto region = cb.read_region();
+            if(region.empty()){
+                std::this_thread::yield();
+                continue;
+            }
+            size_t offset = 0;
+            while(offset + sizeof(uint32_t) <= region.size){
+                uint32_t len;
+                std::memcpy(&len, region.data + offset, sizeof(len));
+                // 生产者一次提交一整条消息，所以区域里不会有半条
+                if(len != static_cast<uint32_t>(1 + received % 200) || offset + sizeof(len) + len > region.size){
+                    corrupted++;
+                    break;
+                }
+                const char* body = region.data + offset + sizeof(len);
+                for(uint32_t k = 0; k < len; k++){
+                    if(body[k] != 'a' + received % 26){
+                        corrupted++;
+                        break;
+                    }
+                }
+                offset += sizeof(len) + len;
+                received++;
+            }
+            cb.consume(offset);
+        }
+        producer.join();
+        std::cout << "received " << received << " messages, corrupted or split: " << corrupted << " (expect 0), empty: "
+                  << std::boolalpha << cb.empty() << std::endl;
+    }
+
+    // 字节流吞吐：加锁模式逐字节 push/pop，对比 Bip 模式 4KB 一段直接 memcpy
+    void bip_benchmark(){
+        std::cout << "=== CircularBuffer Bip Benchmark ===" << std::endl;
+        auto report = [](const char* name, size_t bytes, std::chrono::steady_clock::time_point begin){
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << name << ": " << bytes / seconds / 1e6 << " MB/s" << std::endl;
+        };
+        {
+            const size_t bytes = 4 << 20;
+            CircularBuffer<char> locked(64 * 1024);
+            auto begin = std::chrono::steady_clock::now();
+            std::thread producer([&locked, bytes](){
+                for(size_t i = 0; i < bytes; i++){
+                    locked.push(static_cast<char>(i));
+                }
+            });
+            for(size_t i = 0; i < bytes; i++){
+                locked.pop();
+            }
+            producer.join();
+            report("locked, 1 byte per call", bytes, begin);
+        }
+        {
+            const size_t bytes = size_t(1) << 30;
+            const size_t chunk = 4096;
+            CircularBuffer<char, BufferMode::Bip> bip(64 * 1024);
+            std::vector<char> source(chunk, 'x');
+            std::vector<char> sink(chunk);
+            auto begin = std::chrono::steady_clock::now();
+            std::thread producer([&bip, &source, bytes, chunk](){
+                for(size_t sent = 0; sent < bytes; sent += chunk){
+                    CircularBuffer<char, BufferMode::Bip>::Region region;
+                    while((region = bip.write_region(chunk)).empty()){
+                        std::this_thread::yield();
+                    }
+                    std::memcpy(region.data, source.data(), chunk); // 相当于 recv() 直接写进缓冲区
+                    bip.commit(chunk);
+                }
+            });
+            size_t received = 0;
+            while(received < bytes){
+                auto region = bip.read_region();
+                if(region.empty()){
+                    std::this_thread::yield();
+                    continue;
+                }
+                size_t n = std::min(region.size, chunk);
+                std::memcpy(sink.data(), region.data, n);
+                bip.consume(n);
+                received += n;
+            }
+            producer.join();
+            report("bip, 4KB regions       ", bytes, begin);
+        }
+    }
+
+    struct TraceEvent{
+        uint64_t thread;
+        uint64_t seq;
+        uint64_t check;   // thread * 1000003 + seq，用来判断是不是读到了半条
+    };
+
+    /*
+     *  覆盖模式：单线程下看覆盖和 dropped；再让一个线程一直写，一个线程同时取快照、一个线程同时消费，
+     *  读到的每条记录都必须完整，并且按顺序连续
+     */
+    void overwrite_test(){
+        std::cout << "=== CircularBuffer Overwrite Test ===" << std::endl;
+        CircularBuffer<int, BufferMode::Overwrite> small(8);
+        for(int i = 0; i < 20; i++){
+            small.push(i);
+        }
+        std::cout << "snapshot:";
+        for(int v : small.snapshot()){
+            std::cout << " " << v;
+        }
+        std::cout << " (expect 12..19)" << std::endl;
+        int first = -1;
+        small.try_pop(first);
+        std::cout << "first pop " << first << ", dropped " << small.dropped() << " (expect 12, 12)" << std::endl;
+
+        // 没有默认构造函数的记录也能 snapshot
+        struct Sample{
+            explicit Sample(int v) : value(v) {}
+            int value;
+        };
+        CircularBuffer<Sample, BufferMode::Overwrite> samples(4);
+        for(int i = 0; i < 6; i++){
+            samples.push(Sample(i));
+        }
+        std::cout << "sample snapshot:";
+        for(const Sample& sample : samples.snapshot()){
+            std::cout << " " << sample.value;
+        }
+        std::cout << " (expect 2 3 4 5)" << std::endl;
+
+        CircularBuffer<TraceEvent, BufferMode::Overwrite> recorder(1024);
+        std::atomic<bool> stop{false};
+        std::thread writer([&recorder, &stop](){
+            for(uint64_t seq = 0; !stop.load(std::memory_order_relaxed); seq++){
+                recorder.push(TraceEvent{7, seq, 7 * 1000003 + seq});
+            }
+        });
+        // 消费者：取到的序号只会变大，跳过的都记在 dropped 里
+        size_t popped = 0;
+        size_t pop_errors = 0;
+        std::thread consumer([&](){
+            uint64_t next = 0;
+            TraceEvent e;
+            while(!stop.load(std::memory_order_relaxed)){
+                if(!recorder.try_pop(e)){
+                    continue;
+                }
+                pop_errors += e.check != 7 * 1000003 + e.seq || e.seq < next;
+                next = e.seq + 1;
+                popped++;
+            }
+        });
+        size_t snapshots = 0;
+        size_t records = 0;
+        size_t torn = 0;
+        size_t gaps = 0;
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+        while(std::chrono::steady_clock::now() < end){
+            auto window = recorder.snapshot();
+            for(size_t i = 0; i < window.size(); i++){
+                torn += window[i].check != 7 * 1000003 + window[i].seq;
+                gaps += i > 0 && window[i].seq != window[i - 1].seq + 1;
+            }
+            snapshots++;
+            records += window.size();
+        }
+        stop = true;
+        writer.join();
+        consumer.join();
+        std::cout << snapshots << " snapshots, " << records / (snapshots ? snapshots : 1) << " records each, torn: " << torn
+                  << ", gaps: " << gaps << " (expect 0, 0)" << std::endl;
+        std::cout << "written " << recorder.written() << ", popped " << popped << ", dropped " << recorder.dropped()
+                  << ", pop errors: " << pop_errors << " (expect 0)" << std::endl;
+    }
+
+    // 写入方每条的耗时：1 个和 4 个写入线程（各自一个缓冲区），以及同时有线程不停取快照时
+    void overwrite_benchmark(){
+        std::cout << "=== CircularBuffer Overwrite Benchmark ===" << std::endl;
+        const uint64_t per_thread = 10000000;
+        for(int threads : {1, 4}){
+            for(bool reading : {false, true}){
+                std::vector<std::unique_ptr<CircularBuffer<TraceEvent, BufferMode::Overwrite>>> recorders;
+                for(int t = 0; t < threads; t++){
+                    recorders.emplace_back(new CircularBuffer<TraceEvent, BufferMode::Overwrite>(4096));
+                }
+                std::atomic<bool> stop{false};
+                std::thread reader;
+                size_t snapshots = 0;
+                if(reading){
+                    reader = std::thread([&](){
+                        while(!stop.load()){
+                            for(auto& r : recorders){
+                                r->snapshot(256);
+                            }
+                            snapshots++;
+                        }
+                    });
+                }
+                std::vector<std::thread> writers;
+                auto begin = std::chrono::steady_clock::now();
+                for(int t = 0; t < threads; t++){
+                    writers.emplace_back([&recorders, t, per_thread](){
+                        auto& recorder = *recorders[t];
+                        for(uint64_t seq = 0; seq < per_thread; seq++){
+                            recorder.push(TraceEvent{uint64_t(t), seq, seq});
+                        }
+                    });
+                }
+                for(auto& w : writers){
+                    w.join();
+                }
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+                stop = true;
+                if(reader.joinable()){
+                    reader.join();
+                }
+                std::cout << threads << " writers" << (reading ? " + snapshot reader" : "                  ") << ": "
+                          << ns / (threads * per_thread) << " ns per push";
+                if(reading){
+                    std::cout << ", " << snapshots << " snapshots";
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+
+#ifdef __linux__
+    // 镜像模式：跨越结尾写入的数据读出来是连续的；再用随机长度的块跑一个生产者/消费者流，每次整段读走
+    void mirrored_test(){
+        std::cout << "=== CircularBuffer Mirrored Test ===" << std::endl;
+        CircularBuffer<char, BufferMode::Mirrored> cb(4096);
+        size_t cap = cb.capacity();
+        auto w = cb.write_region();
+        cb.commit(cap - 10);
+        cb.consume(cb.read_region().size);
+        w = cb.write_region();
+        std::memcpy(w.data, "hello, mirrored ring", 20); // 前 10 个字节在结尾，后 10 个回到开头
+        cb.commit(20);
+        auto r = cb.read_region();
+        std::cout << "capacity " << cap << ", read across the end: \"" << std::string(r.data, r.size)
+                  << "\" (expect \"hello, mirrored ring\")" << std::endl;
+        cb.consume(r.size);
+
+        const size_t bytes = 64 << 20;
+        CircularBuffer<uint8_t, BufferMode::Mirrored> stream(64 * 1024);
+        std::thread producer([&stream, bytes](){
+            std::mt19937 rng(7);
+            size_t sent = 0;
+            while(sent < bytes){
+                auto region = stream.write_region();
+                size_t n = std::min({region.size, size_t(1 + rng() % 20000), bytes - sent});
+                for(size_t i = 0; i < n; i++){
+                    region.data[i] = static_cast<uint8_t>(sent + i);
+                }
+                stream.commit(n);
+                sent += n;
+                if(n == 0){
+                    std::this_thread::yield();
+                }
+            }
+        });
+        std::atomic<bool> observing{true};
+        size_t bad_sizes = 0;
+        std::thread observer([&stream, &observing, &bad_sizes](){
+            while(observing.load(std::memory_order_relaxed)){
+                bad_sizes += stream.size() > stream.capacity();
+            }
+        });
+        size_t received = 0;
+        size_t errors = 0;
+        while(received < bytes){
+            auto region = stream.read_region();
+            for(size_t i = 0; i < region.size; i++){
+                errors += region.data[i] != static_cast<uint8_t>(received + i);
+            }
+            stream.consume(region.size);
+            received += region.size;
+            if(region.empty()){
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        observing = false;
+        observer.join();
+        std::cout << "streamed " << (bytes >> 20) << "MB, errors: " << errors << ", size() over capacity: " << bad_sizes
+                  << " (expect 0, 0)" << std::endl;
+    }
+
+    // 整段交给 write()：每次把全部可读数据写到 /dev/null，对比 Bip 模式（回绕处要分两次）
+    void mirrored_benchmark(){
+        std::cout << "=== CircularBuffer Mirrored Benchmark ===" << std::endl;
+        const size_t bytes = size_t(1) << 30;
+        int null_fd = ::open("/dev/null", O_WRONLY);
+        auto run = [null_fd, bytes](const char* name, auto& cb){
+            size_t calls = 0;
+            auto begin = std::chrono::steady_clock::now();
+            std::thread producer([&cb, bytes](){
+                std::mt19937 rng(9);
+                for(size_t sent = 0; sent < bytes;){
+                    size_t n = std::min<size_t>(1 + rng() % 30000, bytes - sent);
+                    auto region = cb.write_region(n);
+                    if(region.size < n){
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    std::memset(region.data, 'x', n);
+                    cb.commit(n);
+                    sent += n;
+                }
+            });
+            for(size_t received = 0; received < bytes;){
+                auto region = cb.read_region();
+                if(region.empty()){
+                    std::this_thread::yield();
+                    continue;
+                }
+                ssize_t n = ::write(null_fd, region.data, region.size);
+                (void)n;
+                cb.consume(region.size);
+                received += region.size;
+                calls++;
+            }
+            producer.join();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << name << ": " << bytes / seconds / 1e6 << " MB/s, " << calls << " write() calls" << std::endl;
+        };
+        CircularBuffer<char, BufferMode::Bip> bip(256 * 1024);
+        run("bip     ", bip);
+        CircularBuffer<char, BufferMode::Mirrored> mirrored(256 * 1024);
+        run("mirrored", mirrored);
+        ::close(null_fd);
+    }
+#endif
+
+#ifdef __linux__
+    static void pin_to_cpu(unsigned cpu){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    static void pin_to_cpu(unsigned){}
+#endif
+
+    // 生产者、消费者各绑一个核，对比加锁模式和 SPSC 模式每秒交接的元素数
+    void spsc_benchmark(){
+        std::cout << "=== CircularBuffer SPSC Benchmark ===" << std::endl;
+        unsigned cpus = std::thread::hardware_concurrency();
+        std::cout << "cpus: " << cpus << (cpus < 2 ? " (producer and consumer share one core)" : "") << std::endl;
+        auto run = [cpus](const char* name, auto& cb, uint64_t n){
+            auto begin = std::chrono::steady_clock::now();
+            std::thread producer([&cb, n](){
+                pin_to_cpu(0);
+                for(uint64_t i = 0; i < n; i++){
+                    cb.push(i);
+                }
+            });
+            std::thread consumer([&cb, n, cpus](){
+                pin_to_cpu(cpus > 1 ? 1 : 0);
+                uint64_t sum = 0;
+                for(uint64_t i = 0; i < n; i++){
+                    sum += cb.pop();
+                }
+                if(sum != n * (n - 1) / 2){
+                    std::cout << "wrong sum" << std::endl;
+                }
+            });
+            producer.join();
+            consumer.join();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << name << ": " << n / seconds / 1e6 << "M ops/s" << std::endl;
+        };
+        CircularBuffer<uint64_t> locked(1024);
+        run("locked", locked, 2000000);
+        CircularBuffer<uint64_t, BufferMode::SPSC> spsc(1024);
+        run("spsc  ", spsc, 100000000);
+    }
 }
 
 
@@ -8,6 +8,10 @@
 #include <atomic>
 #include <memory>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 
 template<typename T>
 struct LockFreeQueueNode{
@@ -16,33 +20,111 @@ struct LockFreeQueueNode{
 
     LockFreeQueueNode():data(nullptr),next(nullptr){}
 };
+/*
+ *  Michael-Scott 无锁队列，节点用危险指针（hazard pointer）回收：
+ *  每个线程在队列上有一条记录，访问节点前先把指针发布到记录里再二次确认，
+ *  出队摘下的旧头节点先放进本线程的待回收列表，攒够一批后扫描所有记录，没人引用的才 delete。
+ *  被引用的节点不会释放，地址也就不会被复用，头尾指针的 CAS 不会遇到 ABA
+ */
 template<typename T>
 class LockFreeQueue{
 private:
-    std::atomic<LockFreeQueueNode<T>*> head;
-    std::atomic<LockFreeQueueNode<T>*> tail;
+    using Node = LockFreeQueueNode<T>;
+
+    struct HazardRecord{
+        std::atomic<Node*> hazard[2];
+        std::atomic<bool> in_use{true};
+        HazardRecord* next = nullptr;
+        std::vector<Node*> retired;     // 只由持有这条记录的线程访问
+
+        HazardRecord(){
+            hazard[0].store(nullptr);
+            hazard[1].store(nullptr);
+        }
+    };
+
+    // 记录和待回收节点放在单独的对象里：线程退出可能晚于队列析构，最后一个持有者负责释放
+    struct Domain{
+        std::atomic<HazardRecord*> records{nullptr};
+        std::atomic<size_t> record_count{0};
+
+        ~Domain(){
+            HazardRecord* rec = records.load();
+            while(rec != nullptr){
+                HazardRecord* next = rec->next;
+                for(Node* node : rec->retired){
+                    delete node;
+                }
+                delete rec;
+                rec = next;
+            }
+        }
+
+        // 先找一条空闲的记录复用，没有再新建并压到链表头；记录只增不删
+        HazardRecord* acquire(){
+            for(HazardRecord* rec = records.load(); rec != nullptr; rec = rec->next){
+                bool expected = false;
+                if(!rec->in_use.load(std::memory_order_relaxed) && rec->in_use.compare_exchange_strong(expected,true)){
+                    return rec;
+                }
+            }
+            HazardRecord* rec = new HazardRecord();
+            HazardRecord* old = records.load();
+            do{
+                rec->next = old;
+            }while(!records.compare_exchange_weak(old,rec));
+            record_count.fetch_add(1);
+            return rec;
+        }
+    };
+
+    struct LocalRecord{
+        std::shared_ptr<Domain> domain;
+        HazardRecord* record;
+    };
+
+    // 线程退出时把记录还回去，没回收完的节点留在记录里，由下一个使用者或 Domain 析构处理
+    struct LocalRecords{
+        std::vector<LocalRecord> records;
+
+        ~LocalRecords(){
+            for(LocalRecord& r : records){
+                r.record->hazard[0].store(nullptr);
+                r.record->hazard[1].store(nullptr);
+                r.record->in_use.store(false);
+            }
+        }
+    };
+
+    std::atomic<Node*> head;
+    std::atomic<Node*> tail;
+    std::shared_ptr<Domain> domain_;
 public:
-    LockFreeQueue(){
-        LockFreeQueueNode<T>* dummy = new LockFreeQueueNode<T>();
+    LockFreeQueue():domain_(std::make_shared<Domain>()){
+        Node* dummy = new Node();
         head.store(dummy);
         tail.store(dummy);
     }
     ~LockFreeQueue(){
         while(head.load()!= nullptr){
-            LockFreeQueueNode<T>* node = head.load();
+            Node* node = head.load();
             head.store(node->next.load());
             delete node;
         }
     }
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
 
     void enqueue(T* item){
-        LockFreeQueueNode<T>* node = new LockFreeQueueNode<T>();
+        Node* node = new Node();
         node->data.store(item);
+        HazardRecord* rec = local();
 
-        LockFreeQueueNode<T>* prev_tail = tail.load();
+        Node* prev_tail;
         // 循环等待
         while(1){
-            LockFreeQueueNode<T>* nxt = prev_tail->next.load();
+            prev_tail = protect(rec,0,tail);
+            Node* nxt = prev_tail->next.load();
             if(prev_tail==tail.load()){
                 // 双重检查
                 if(nxt == nullptr){
@@ -57,41 +139,120 @@ public:
             }
         }
         // 最终更新
-        tail.compare_exchange_weak(prev_tail,node);
+        tail.compare_exchange_strong(prev_tail,node);
+        rec->hazard[0].store(nullptr,std::memory_order_release);
     }
 
     T* dequeue(){
+        HazardRecord* rec = local();
         while(true){
-            LockFreeQueueNode<T>* first = head.load();
-            LockFreeQueueNode<T>* last = tail.load();
-            LockFreeQueueNode<T>* next = first->next.load();
-
-            if(first == head.load()){
-                if(first == last){
-                    if(next == nullptr){
-                        return nullptr;// 队列空
-                    }
-                    //队列不为空，但是tail滞后
-                    tail.compare_exchange_weak(last,next);
-                }
-                else{
-                    T* result = next->data.load();
-                    if(head.compare_exchange_weak(first,next)){
-                        delete first;
-                        return result;
-                    }
-                }
+            Node* first = protect(rec,0,head);
+            Node* last = tail.load();
+            Node* next = first->next.load();
+            // next 也要保护：读 data 时它可能已经成了别人摘下的旧头
+            rec->hazard[1].store(next);
+            if(first != head.load()){
+                continue;
+            }
+            if(next == nullptr){
+                clear(rec);
+                return nullptr;// 队列空
+            }
+            if(first == last){
+                //队列不为空，但是tail滞后
+                tail.compare_exchange_weak(last,next);
+                continue;
+            }
+            T* result = next->data.load();
+            if(head.compare_exchange_weak(first,next)){
+                clear(rec);
+                retire(rec,first);
+                return result;
             }
         }
     }
 
     bool empty()
     {
-        LockFreeQueueNode<T>* first = head.load();
-        LockFreeQueueNode<T>* next = first->next.load();
+        HazardRecord* rec = local();
+        Node* first = protect(rec,0,head);
+        Node* next = first->next.load();
+        clear(rec);
         return next == nullptr;
     }
 
+private:
+    // 发布危险指针后再读一次源，相同说明发布时节点还在队列里，之后就不会被释放
+    static Node* protect(HazardRecord* rec,int i,const std::atomic<Node*>& src){
+        Node* p = src.load();
+        while(1){
+            rec->hazard[i].store(p);
+            Node* again = src.load();
+            if(again == p){
+                return p;
+            }
+            p = again;
+        }
+    }
+
+    static void clear(HazardRecord* rec){
+        rec->hazard[0].store(nullptr,std::memory_order_release);
+        rec->hazard[1].store(nullptr,std::memory_order_release);
+    }
+
+    // 待回收数超过所有记录危险指针总数的两倍才扫描，每次扫描至少释放一半，摊还 O(1)
+    void retire(HazardRecord* rec,Node* node){
+        rec->retired.push_back(node);
+        if(rec->retired.size() >= std::max<size_t>(64,4*domain_->record_count.load(std::memory_order_relaxed))){
+            scan(rec);
+        }
+    }
+
+    void scan(HazardRecord* rec){
+        std::vector<Node*> hazards;
+        for(HazardRecord* r = domain_->records.load(); r != nullptr; r = r->next){
+            for(auto& h : r->hazard){
+                Node* p = h.load();
+                if(p != nullptr){
+                    hazards.push_back(p);
+                }
+            }
+        }
+        std::sort(hazards.begin(),hazards.end());
+        std::vector<Node*>& retired = rec->retired;
+        size_t kept = 0;
+        for(Node* node : retired){
+            if(std::binary_search(hazards.begin(),hazards.end(),node)){
+                retired[kept++] = node;
+            }
+            else{
+                delete node;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    HazardRecord* local(){
+        static thread_local LocalRecords local;
+        std::vector<LocalRecord>& records = local.records;
+        for(LocalRecord& r : records){
+            if(r.domain == domain_){
+                return r.record;
+            }
+        }
+        // 顺便清掉已经销毁的队列：只剩本线程持有 Domain
+        for(size_t i = 0; i < records.size();){
+            if(records[i].domain.use_count() == 1){
+                records[i] = std::move(records.back());
+                records.pop_back();
+            }
+            else{
+                i++;
+            }
+        }
+        records.push_back(LocalRecord{domain_,domain_->acquire()});
+        return records.back().record;
+    }
 };
 
 namespace LockFreeQueue_Test{
@@ -133,6 +294,89 @@ namespace LockFreeQueue_Test{
 
         std::cout << "end" << std::endl << std::endl;
     }
+
+    /*
+     *  4 个生产者、4 个消费者同时操作，每个值必须恰好出队一次，且同一个生产者的值按顺序出队。
+     *  回收不安全时这里在 TSAN/ASAN 下会报 use-after-free
+     */
+    void stress_test(){
+        std::cout << "=== LockFreeQueue Stress Test ===" << std::endl;
+        const int producers = 4;
+        const int consumers = 4;
+        const int per_producer = 100000;
+        LockFreeQueue<int> queue;
+        std::vector<int> values(producers * per_producer);
+        for(size_t i = 0; i < values.size(); i++){
+            values[i] = static_cast<int>(i);
+        }
+        std::vector<std::atomic<int>> seen(values.size());
+        std::atomic<int> consumed{0};
+        std::atomic<bool> out_of_order{false};
+
+        std::vector<std::thread> threads;
+        for(int p = 0; p < producers; p++){
+            threads.emplace_back([&, p](){
+                for(int i = 0; i < per_producer; i++){
+                    queue.enqueue(&values[p * per_producer + i]);
+                }
+            });
+        }
+        for(int c = 0; c < consumers; c++){
+            threads.emplace_back([&](){
+                std::vector<int> last(producers, -1);
+                while(consumed.load() < producers * per_producer){
+                    int* v = queue.dequeue();
+                    if(v == nullptr){
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    seen[*v]++;
+                    int p = *v / per_producer;
+                    if(*v <= last[p]){
+                        out_of_order = true;
+                    }
+                    last[p] = *v;
+                    consumed++;
+                }
+            });
+        }
+        for(auto& t : threads){
+            t.join();
+        }
+        int bad = 0;
+        for(auto& n : seen){
+            bad += n.load() != 1;
+        }
+        std::cout << "values not seen exactly once: " << bad << " (expect 0), out of order: "
+                  << (out_of_order ? "true" : "false") << " (expect false), empty: "
+                  << (queue.empty() ? "true" : "false") << std::endl;
+    }
+
+    // 每个线程交替入队、出队，1~32 个线程的总吞吐
+    void benchmark(){
+        std::cout << "=== LockFreeQueue Benchmark ===" << std::endl;
+        const int ops_per_thread = 200000;
+        for(int threads : {1, 2, 4, 8, 16, 32}){
+            LockFreeQueue<int> queue;
+            int value = 0;
+            std::vector<std::thread> workers;
+            auto begin = std::chrono::steady_clock::now();
+            for(int t = 0; t < threads; t++){
+                workers.emplace_back([&](){
+                    for(int i = 0; i < ops_per_thread; i++){
+                        queue.enqueue(&value);
+                        while(queue.dequeue() == nullptr){
+                        }
+                    }
+                });
+            }
+            for(auto& w : workers){
+                w.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << threads << " threads: " << 2.0 * threads * ops_per_thread / seconds / 1e6 << "M ops/s" << std::endl;
+        }
+    }
 };
 
 
@@ -0,0 +1,342 @@
+#ifndef CPP_LEARN_MPMCQUEUE_H
+#define CPP_LEARN_MPMCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include "LockFreeQueue.h"
+#include "../Concurrent_Control_Component/ProducerConsumerQueue.h"
+
+/*
+ *  有界多生产者多消费者队列（数组 + 每槽序号，Vyukov 算法），按值存 T，支持只能移动的类型
+ *  容量向上取 2 的幂，下标用掩码。每个槽有一个序号：
+ *      seq == pos        空槽，等待第 pos 个入队
+ *      seq == pos + 1    已写入，等待第 pos 个出队
+ *  入队/出队各自只 CAS 自己的游标，生产者和消费者不抢同一个变量；两个游标分开放在不同缓存行
+ *
+ *  try_push/try_pop 满/空时立刻返回 false；push/pop 先领一个号再等自己的槽，
+ *  等待是自旋后 yield，适合线程之间忙碌的交接，长时间空闲的等待用 ProducerConsumerQueue
+ *
+ *  领到槽位以后不能再失败，否则槽的序号不再前进，后面的出队会一直等：
+ *  入队先在槽外构造好 T 再移进去，出队用移动赋值取出，所以要求 T 的移动构造和移动赋值不抛异常
+ */
+template<typename T>
+class MPMCQueue{
+    static_assert(std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_assignable<T>::value,
+                  "MPMCQueue requires nothrow move construction and move assignment");
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    struct Cell{
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value(){
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    static size_t round_up(size_t n){
+        size_t cap = 2;
+        while(cap < n){
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    // 等自己的槽轮到：先空转一小会儿，再让出 CPU
+    template<typename Ready>
+    static void wait_until(Ready ready){
+        for(int spin = 0; !ready(); spin++){
+            if(spin >= 64){
+                std::this_thread::yield();
+            }
+        }
+    }
+
+public:
+    explicit MPMCQueue(size_t capacity)
+        : mask_(round_up(capacity) - 1),
+          cells_(new Cell[mask_ + 1]){
+        if(capacity == 0){
+            throw std::invalid_argument("MPMCQueue capacity must be positive");
+        }
+        for(size_t i = 0; i <= mask_; i++){
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // 析构时不能再有线程在用
+    ~MPMCQueue(){
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t end = enqueue_pos_.load(std::memory_order_relaxed);
+        for(; pos != end; pos++){
+            Cell& cell = cells_[pos & mask_];
+            if(cell.sequence.load(std::memory_order_relaxed) == pos + 1){
+                cell.value()->~T();
+            }
+        }
+    }
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args){
+        T item(std::forward<Args>(args)...); // 构造抛异常时还没领槽位
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true){
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if(diff == 0){
+                if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    break;
+                }
+            }
+            else if(diff < 0){
+                return false; // 满了：这个槽上一圈的值还没被取走
+            }
+            else{
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::move(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T& item){
+        return try_emplace(item);
+    }
+    bool try_push(T&& item){
+        return try_emplace(std::move(item));
+    }
+
+    bool try_pop(T& value){
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true){
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if(diff == 0){
+                if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    break;
+                }
+            }
+            else if(diff < 0){
+                return false; // 空的
+            }
+            else{
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        take(*cell, pos, value);
+        return true;
+    }
+
+    // 队列满时等待
+    template<typename... Args>
+    void emplace(Args&&... args){
+        T item(std::forward<Args>(args)...);
+        size_t pos = enqueue_pos_.fetch_add(1, std::memory_order_relaxed);
+        Cell& cell = cells_[pos & mask_];
+        wait_until([&cell, pos](){ return cell.sequence.load(std::memory_order_acquire) == pos; });
+        new (cell.storage) T(std::move(item));
+        cell.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void push(const T& item){
+        emplace(item);
+    }
+    void push(T&& item){
+        emplace(std::move(item));
+    }
+
+    // 队列空时等待
+    void pop(T& value){
+        size_t pos = dequeue_pos_.fetch_add(1, std::memory_order_relaxed);
+        Cell& cell = cells_[pos & mask_];
+        wait_until([&cell, pos](){ return cell.sequence.load(std::memory_order_acquire) == pos + 1; });
+        take(cell, pos, value);
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+    // 并发时只是近似值；阻塞 pop 先领号时可能暂时为“负”，按 0 算
+    size_t size_approx() const {
+        size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    // 取出值后把槽交给下一圈的入队者
+    void take(Cell& cell, size_t pos, T& value){
+        T* item = cell.value();
+        value = std::move(*item);
+        item->~T();
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos_{0};
+    alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos_{0};
+    char pad_[CACHE_LINE - sizeof(std::atomic<size_t>)];
+};
+
+namespace MPMCQueue_Test{
+    void test(){
+        std::cout << "=== MPMCQueue Test ===" << std::endl;
+        // 只能移动的类型、容量取整、满/空
+        MPMCQueue<std::unique_ptr<int>> queue(3);
+        std::cout << "capacity: " << queue.capacity() << " (expect 4)" << std::endl;
+        int pushed = 0;
+        while(queue.try_push(std::make_unique<int>(pushed))){
+            pushed++;
+        }
+        std::cout << "pushed until full: " << pushed << " (expect 4)" << std::endl;
+        std::unique_ptr<int> out;
+        std::cout << "pop order:";
+        while(queue.try_pop(out)){
+            std::cout << " " << *out;
+        }
+        std::cout << " (expect 0 1 2 3)" << std::endl;
+
+        // 拷贝构造抛异常：槽位还没领，队列照常可用
+        struct Flaky{
+            int value;
+            explicit Flaky(int v) : value(v) {}
+            Flaky(const Flaky& other) : value(other.value){
+                if(value < 0){
+                    throw std::runtime_error("copy failed");
+                }
+            }
+            Flaky(Flaky&&) noexcept = default;
+            Flaky& operator=(Flaky&&) noexcept = default;
+        };
+        MPMCQueue<Flaky> flaky(2);
+        Flaky bad(-1);
+        Flaky good(7);
+        try{
+            flaky.push(bad);
+        }
+        catch(const std::runtime_error&){
+        }
+        flaky.push(good);
+        Flaky got(0);
+        bool popped = flaky.try_pop(got);
+        std::cout << "after throwing push: " << popped << " " << got.value << " (expect 1 7)" << std::endl;
+
+        // 4 个生产者、4 个消费者，阻塞和非阻塞接口混用，总和必须对上
+        const int producers = 4;
+        const int per_producer = 100000;
+        MPMCQueue<int64_t> shared(64);
+        std::atomic<int64_t> sum{0};
+        std::vector<std::thread> threads;
+        for(int p = 0; p < producers; p++){
+            threads.emplace_back([&shared, p](){
+                for(int i = 1; i <= per_producer; i++){
+                    if(p % 2 == 0){
+                        shared.push(i);
+                    }
+                    else{
+                        while(!shared.try_push(i)){
+                            std::this_thread::yield();
+                        }
+                    }
+                }
+            });
+        }
+        for(int c = 0; c < producers; c++){
+            threads.emplace_back([&shared, &sum, c](){
+                int64_t local = 0;
+                for(int i = 0; i < per_producer; i++){
+                    int64_t v;
+                    if(c % 2 == 0){
+                        shared.pop(v);
+                    }
+                    else{
+                        while(!shared.try_pop(v)){
+                            std::this_thread::yield();
+                        }
+                    }
+                    local += v;
+                }
+                sum += local;
+            });
+        }
+        for(auto& t : threads){
+            t.join();
+        }
+        int64_t expect = int64_t(producers) * per_producer * (per_producer + 1) / 2;
+        std::cout << "sum: " << sum.load() << " (expect " << expect << "), left: " << shared.size_approx() << std::endl;
+    }
+
+    // P 个生产者、P 个消费者传 int，对比 MPMCQueue、LockFreeQueue（每次入队 new 一个节点）和加锁的 ProducerConsumerQueue
+    void benchmark(){
+        std::cout << "=== MPMCQueue Benchmark ===" << std::endl;
+        const int items = 1000000;
+        auto run = [](const char* name, int pairs, auto push, auto pop){
+            std::vector<std::thread> threads;
+            auto begin = std::chrono::steady_clock::now();
+            for(int p = 0; p < pairs; p++){
+                threads.emplace_back([&push, pairs](){
+                    for(int i = 0; i < items / pairs; i++){
+                        push(i);
+                    }
+                });
+                threads.emplace_back([&pop, pairs](){
+                    for(int i = 0; i < items / pairs; i++){
+                        pop();
+                    }
+                });
+            }
+            for(auto& t : threads){
+                t.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << "  " << name << ": " << items / seconds / 1e6 << "M items/s" << std::endl;
+        };
+        for(int pairs : {1, 2, 4}){
+            std::cout << pairs << " producers / " << pairs << " consumers" << std::endl;
+            {
+                MPMCQueue<int> queue(1024);
+                run("MPMCQueue", pairs,
+                    [&queue](int i){ queue.push(i); },
+                    [&queue](){ int v; queue.pop(v); });
+            }
+            {
+                LockFreeQueue<int> queue;
+                std::vector<int> values(items);
+                run("LockFreeQueue", pairs,
+                    [&queue, &values](int i){ queue.enqueue(&values[i]); },
+                    [&queue](){
+                        while(queue.dequeue() == nullptr){
+                            std::this_thread::yield();
+                        }
+                    });
+            }
+            {
+                ProducerConsumerQueue<int> queue(1024);
+                run("ProducerConsumerQueue", pairs,
+                    [&queue](int i){ queue.push(i); },
+                    [&queue](){ int v; queue.pop(v); });
+            }
+        }
+    }
+};
+
+#endif //CPP_LEARN_MPMCQUEUE_H
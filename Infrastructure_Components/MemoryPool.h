@@ -0,0 +1,755 @@
+#ifndef CPP_LEARN_MEMORYPOOL_H
+#define CPP_LEARN_MEMORYPOOL_H
+
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <list>
+#include <map>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+/*
+ *  按大小分级的 slab 内存池
+ *  每个大小级别单独向系统申请 64KB、按页对齐的 chunk，切成等长的块；
+ *  每个线程对每个级别持有两个“弹匣”（装空闲块指针的定长数组），分配和释放大多只碰本线程的弹匣，不加锁；
+ *  弹匣空了或满了，才加该级别的锁和全局仓库整只交换。超过 MAX_SIZE 的请求直接走 operator new
+ *
+ *  和 CachedObjectPool 一样，仓库和 chunk 放在共享的 Core 里，线程退出时把弹匣还回仓库；
+ *  内存只在 SlabAllocator 和所有用过它的线程都结束后才还给系统
+ */
+class SlabAllocator {
+public:
+    static constexpr size_t PAGE_SIZE = 4096;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t ALIGNMENT = 16;       // 所有块都按 16 字节对齐
+    static constexpr size_t MAX_SIZE = 2048;
+    static constexpr size_t CLASS_COUNT = 24;
+    static constexpr size_t MAGAZINE_CAPACITY = 64;
+    // 小块按 16 字节递增，之后每翻一倍分 4 档，块内浪费不超过 25%
+    static constexpr std::array<uint16_t, CLASS_COUNT> CLASS_SIZES = {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        160, 192, 224, 256, 320, 384, 448, 512,
+        640, 768, 896, 1024, 1280, 1536, 1792, 2048
+    };
+
+    SlabAllocator() : core(std::make_shared<Core>()) {}
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    void* allocate(size_t bytes) {
+        if(bytes > MAX_SIZE) {
+            return ::operator new(bytes);
+        }
+        size_t c = size_class(bytes);
+        Cache& cache = local();
+        Magazine* m = cache.loaded[c];
+        if(m != nullptr && m->count > 0) {
+            return m->items[--m->count];
+        }
+        return refill(cache, c);
+    }
+
+    // bytes 必须和分配时相同；可以在别的线程释放
+    void deallocate(void* p, size_t bytes) {
+        if(p == nullptr) {
+            return;
+        }
+        if(bytes > MAX_SIZE) {
+            ::operator delete(p);
+            return;
+        }
+        size_t c = size_class(bytes);
+        Cache& cache = local();
+        Magazine* m = cache.loaded[c];
+        if(m != nullptr && m->count < core->classes[c].capacity) {
+            m->items[m->count++] = p;
+            return;
+        }
+        spill(cache, c, p);
+    }
+
+    // 已经向系统申请的 chunk 总字节数
+    size_t reserved_bytes() const {
+        return core->reserved.load(std::memory_order_relaxed);
+    }
+
+    static size_t size_class(size_t bytes) {
+        static const std::array<uint8_t, MAX_SIZE / ALIGNMENT + 1> table = []() {
+            std::array<uint8_t, MAX_SIZE / ALIGNMENT + 1> t{};
+            size_t c = 0;
+            for(size_t i = 0; i < t.size(); i++) {
+                while(CLASS_SIZES[c] < i * ALIGNMENT) {
+                    c++;
+                }
+                t[i] = static_cast<uint8_t>(c);
+            }
+            return t;
+        }();
+        return table[(bytes + ALIGNMENT - 1) / ALIGNMENT];
+    }
+
+private:
+    struct Magazine {
+        size_t count = 0;
+        void* items[MAGAZINE_CAPACITY];
+    };
+
+    // 一个大小级别的全局仓库
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<Magazine*> full;    // 非空的弹匣
+        std::vector<Magazine*> empty;
+        char* cursor = nullptr;         // 当前 chunk 还没切出去的部分
+        char* end = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;            // 弹匣容量，大块少缓存一些，每个弹匣约 16KB
+    };
+
+    struct Core {
+        std::array<SizeClass, CLASS_COUNT> classes;
+        std::mutex chunk_mutex;
+        std::vector<void*> chunks;
+        std::atomic<size_t> reserved{0};
+
+        Core() {
+            for(size_t c = 0; c < CLASS_COUNT; c++) {
+                classes[c].size = CLASS_SIZES[c];
+                classes[c].capacity = std::clamp<size_t>(16384 / CLASS_SIZES[c], 8, MAGAZINE_CAPACITY);
+            }
+        }
+
+        ~Core() {
+            for(SizeClass& sc : classes) {
+                for(Magazine* m : sc.full) {
+                    delete m;
+                }
+                for(Magazine* m : sc.empty) {
+                    delete m;
+                }
+            }
+            for(void* chunk : chunks) {
+                ::operator delete(chunk, std::align_val_t(PAGE_SIZE));
+            }
+        }
+
+        // 调用方持有 sc.mutex
+        Magazine* take_empty(SizeClass& sc) {
+            if(sc.empty.empty()) {
+                return new Magazine();
+            }
+            Magazine* m = sc.empty.back();
+            sc.empty.pop_back();
+            return m;
+        }
+
+        // 调用方持有 sc.mutex；从当前 chunk 切一批块装进 m，chunk 用完了再申请新的
+        void carve(SizeClass& sc, Magazine* m) {
+            if(static_cast<size_t>(sc.end - sc.cursor) < sc.size) {
+                void* chunk = ::operator new(CHUNK_SIZE, std::align_val_t(PAGE_SIZE));
+                {
+                    std::lock_guard<std::mutex> lock(chunk_mutex);
+                    chunks.push_back(chunk);
+                }
+                reserved.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+                sc.cursor = static_cast<char*>(chunk);
+                sc.end = sc.cursor + CHUNK_SIZE;
+            }
+            while(m->count < sc.capacity && static_cast<size_t>(sc.end - sc.cursor) >= sc.size) {
+                m->items[m->count++] = sc.cursor;
+                sc.cursor += sc.size;
+            }
+        }
+
+        // 把弹匣还给仓库
+        void give_back(SizeClass& sc, Magazine* m) {
+            if(m == nullptr) {
+                return;
+            }
+            if(m->count > 0) {
+                sc.full.push_back(m);
+            } else {
+                sc.empty.push_back(m);
+            }
+        }
+    };
+
+    struct Cache {
+        std::shared_ptr<Core> core;
+        std::array<Magazine*, CLASS_COUNT> loaded{};
+        std::array<Magazine*, CLASS_COUNT> previous{};
+
+        void flush() {
+            for(size_t c = 0; c < CLASS_COUNT; c++) {
+                if(loaded[c] == nullptr && previous[c] == nullptr) {
+                    continue;
+                }
+                SizeClass& sc = core->classes[c];
+                std::lock_guard<std::mutex> lock(sc.mutex);
+                core->give_back(sc, loaded[c]);
+                core->give_back(sc, previous[c]);
+                loaded[c] = previous[c] = nullptr;
+            }
+        }
+    };
+
+    // 线程退出时把各个分配器的弹匣还回去
+    struct LocalCaches {
+        std::vector<Cache> caches;
+
+        ~LocalCaches() {
+            for(Cache& c : caches) {
+                c.flush();
+            }
+        }
+    };
+
+    // loaded 空了：先和 previous 交换，再找仓库换一个非空弹匣，都没有就从 chunk 切
+    void* refill(Cache& cache, size_t c) {
+        Magazine*& loaded = cache.loaded[c];
+        Magazine*& previous = cache.previous[c];
+        if(previous != nullptr && previous->count > 0) {
+            std::swap(loaded, previous);
+            return loaded->items[--loaded->count];
+        }
+        SizeClass& sc = core->classes[c];
+        std::lock_guard<std::mutex> lock(sc.mutex);
+        if(!sc.full.empty()) {
+            core->give_back(sc, previous);
+            previous = loaded;
+            loaded = sc.full.back();
+            sc.full.pop_back();
+        } else {
+            if(loaded == nullptr) {
+                loaded = core->take_empty(sc);
+            }
+            core->carve(sc, loaded);
+        }
+        return loaded->items[--loaded->count];
+    }
+
+    // loaded 满了：previous 有空位就交换，否则把满的 previous 交给仓库，换一个空弹匣
+    void spill(Cache& cache, size_t c, void* p) {
+        Magazine*& loaded = cache.loaded[c];
+        Magazine*& previous = cache.previous[c];
+        SizeClass& sc = core->classes[c];
+        if(loaded != nullptr && previous != nullptr && previous->count < sc.capacity) {
+            std::swap(loaded, previous);
+        } else {
+            std::lock_guard<std::mutex> lock(sc.mutex);
+            if(loaded != nullptr) {
+                core->give_back(sc, previous);
+                previous = loaded;
+            }
+            loaded = core->take_empty(sc);
+        }
+        loaded->items[loaded->count++] = p;
+    }
+
+    Cache& local() {
+        static thread_local LocalCaches local;
+        std::vector<Cache>& caches = local.caches;
+        for(Cache& c : caches) {
+            if(c.core == core) {
+                return c;
+            }
+        }
+        // 顺便清掉已经销毁的分配器：只剩本线程持有，没有别人会再用它
+        for(size_t i = 0; i < caches.size();) {
+            if(caches[i].core.use_count() == 1) {
+                caches[i].flush();
+                caches[i] = std::move(caches.back());
+                caches.pop_back();
+            } else {
+                i++;
+            }
+        }
+        caches.push_back(Cache{core, {}, {}});
+        return caches.back();
+    }
+
+    std::shared_ptr<Core> core;
+};
+
+/*
+ *  std::pmr 适配器，让 pmr 容器的节点走 SlabAllocator：
+ *      SlabResource resource;
+ *      std::pmr::list<int> nodes(&resource);
+ *  对齐要求超过 16 字节或超过 MAX_SIZE 的请求交给 upstream
+ */
+class SlabResource : public std::pmr::memory_resource {
+public:
+    explicit SlabResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) : upstream(upstream) {}
+
+    SlabAllocator& allocator() {
+        return slab;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if(alignment <= SlabAllocator::ALIGNMENT && bytes <= SlabAllocator::MAX_SIZE) {
+            return slab.allocate(bytes);
+        }
+        return upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        if(alignment <= SlabAllocator::ALIGNMENT && bytes <= SlabAllocator::MAX_SIZE) {
+            slab.deallocate(p, bytes);
+        } else {
+            upstream->deallocate(p, bytes, alignment);
+        }
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    SlabAllocator slab;
+    std::pmr::memory_resource* upstream;
+};
+
+/*
+ *  单调增长的请求级 arena：分配只是移动指针，单个对象不能释放，整个请求结束后 reset 一次性清掉
+ *  make<T> 构造的对象只有非平凡析构的才登记析构函数，reset 时按构造的逆序调用；
+ *  reset 不把内存还给 upstream，块都留着给下一个请求复用，所以除去析构函数调用是 O(1)，release 才真正归还。
+ *  和 std::pmr::monotonic_buffer_resource 相比多了块复用和带析构的 make<T>；不是线程安全的
+ */
+class MonotonicArena : public std::pmr::memory_resource {
+public:
+    explicit MonotonicArena(size_t initial_block = 4096, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream), next_size(std::max<size_t>(initial_block, 256)) {}
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    ~MonotonicArena() override {
+        release();
+    }
+
+    void* allocate_bytes(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if(current == nullptr || p + bytes > reinterpret_cast<uintptr_t>(end)) {
+            p = reinterpret_cast<uintptr_t>(next_block(bytes, alignment));
+        }
+        cursor = reinterpret_cast<char*>(p + bytes);
+        return reinterpret_cast<void*>(p);
+    }
+
+    // 在 arena 上构造对象，生命周期到下一次 reset/release 为止
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        if constexpr (std::is_trivially_destructible<T>::value) {
+            return new (allocate_bytes(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        } else {
+            // 析构记录也放在 arena 里；先分配记录，构造失败时它只是浪费几个字节
+            auto* record = static_cast<Destructor*>(allocate_bytes(sizeof(Destructor), alignof(Destructor)));
+            T* obj = new (allocate_bytes(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            record->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+            record->object = obj;
+            record->next = destructors;
+            destructors = record;
+            return obj;
+        }
+    }
+
+    // 调用登记的析构函数，指针回到第一个块，块全部保留
+    void reset() {
+        run_destructors();
+        current = head;
+        cursor = head ? head->data() : nullptr;
+        end = head ? head->data() + head->size : nullptr;
+        used_before = 0;
+    }
+
+    // reset 并把所有块还给 upstream
+    void release() {
+        run_destructors();
+        while(head != nullptr) {
+            Block* next = head->next;
+            upstream->deallocate(head, sizeof(Block) + head->size, alignof(Block));
+            head = next;
+        }
+        current = nullptr;
+        cursor = end = nullptr;
+        used_before = 0;
+        reserved = 0;
+    }
+
+    // 本轮已经用掉的字节数（含对齐和块尾浪费）
+    size_t bytes_used() const {
+        return current ? used_before + (cursor - current->data()) : 0;
+    }
+
+    size_t bytes_reserved() const {
+        return reserved;
+    }
+
+private:
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        size_t size;
+
+        char* data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+    };
+
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+        Destructor* next;
+    };
+
+    void run_destructors() {
+        while(destructors != nullptr) {
+            Destructor* d = destructors;
+            destructors = d->next;
+            d->destroy(d->object);
+        }
+    }
+
+    // 当前块放不下：先用 reset 后保留下来的块，放不下就跳过，最后才向 upstream 申请，块大小按 2 倍增长
+    void* next_block(size_t bytes, size_t alignment) {
+        if(current != nullptr) {
+            used_before += current->size;
+        }
+        Block* prev = current;
+        Block* b = current ? current->next : head;
+        while(b != nullptr) {
+            uintptr_t p = (reinterpret_cast<uintptr_t>(b->data()) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+            if(p + bytes <= reinterpret_cast<uintptr_t>(b->data() + b->size)) {
+                break;
+            }
+            used_before += b->size;
+            prev = b;
+            b = b->next;
+        }
+        if(b == nullptr) {
+            size_t size = std::max(next_size, bytes + alignment);
+            next_size = std::min(next_size * 2, MAX_BLOCK);
+            b = static_cast<Block*>(upstream->allocate(sizeof(Block) + size, alignof(Block)));
+            b->size = size;
+            b->next = nullptr;
+            reserved += size;
+            // 挂在 prev 后面，prev 之后原有的块都太小，接在新块后面仍可复用
+            if(prev == nullptr) {
+                b->next = head;
+                head = b;
+            } else {
+                b->next = prev->next;
+                prev->next = b;
+            }
+        }
+        current = b;
+        cursor = b->data();
+        end = b->data() + b->size;
+        return reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t(alignment) - 1));
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        return allocate_bytes(bytes, alignment);
+    }
+
+    // 单个释放什么都不做，等 reset
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    static constexpr size_t MAX_BLOCK = 1 << 20;
+
+    std::pmr::memory_resource* upstream;
+    Block* head = nullptr;
+    Block* current = nullptr;
+    char* cursor = nullptr;
+    char* end = nullptr;
+    size_t next_size;
+    size_t used_before = 0;   // current 之前各块的大小之和
+    size_t reserved = 0;
+    Destructor* destructors = nullptr;
+};
+
+namespace MemoryPool_Test {
+    void test() {
+        std::cout << "=== MemoryPool Test ===" << std::endl;
+        SlabAllocator slab;
+        std::cout << "size class of 1/16/17/129/2048: " << SlabAllocator::size_class(1) << "/" << SlabAllocator::size_class(16)
+                  << "/" << SlabAllocator::size_class(17) << "/" << SlabAllocator::size_class(129) << "/"
+                  << SlabAllocator::size_class(2048) << " (expect 0/0/1/8/23)" << std::endl;
+
+        void* a = slab.allocate(40);
+        slab.deallocate(a, 40);
+        void* b = slab.allocate(33);
+        std::cout << "freed block reused: " << (a == b ? "yes" : "no") << " (expect yes)" << std::endl;
+        std::cout << "aligned: " << (reinterpret_cast<uintptr_t>(b) % SlabAllocator::ALIGNMENT == 0 ? "yes" : "no") << std::endl;
+        slab.deallocate(b, 33);
+
+        // 一个线程分配、另一个线程释放
+        std::vector<void*> blocks;
+        for(int i = 0; i < 10000; i++) {
+            blocks.push_back(slab.allocate(64));
+        }
+        std::thread other([&]() {
+            for(void* p : blocks) {
+                slab.deallocate(p, 64);
+            }
+        });
+        other.join();
+        size_t reserved = slab.reserved_bytes();
+        for(int i = 0; i < 10000; i++) {
+            blocks[i] = slab.allocate(64);
+        }
+        std::cout << "cross-thread blocks reused: " << (slab.reserved_bytes() == reserved ? "yes" : "no") << " (expect yes)" << std::endl;
+        for(void* p : blocks) {
+            slab.deallocate(p, 64);
+        }
+
+        // pmr 容器
+        SlabResource resource;
+        std::pmr::list<int> list(&resource);
+        std::pmr::map<int, std::pmr::string> map(&resource);
+        for(int i = 0; i < 1000; i++) {
+            list.push_back(i);
+            map.emplace(i, std::pmr::string("value with a long enough payload #" + std::to_string(i), &resource));
+        }
+        std::cout << "pmr list size " << list.size() << ", map[999] = " << map[999] << std::endl;
+        std::cout << "slab reserved: " << resource.allocator().reserved_bytes() / 1024 << "KB" << std::endl;
+    }
+
+    // 随机大小（16~512 字节）成批分配再释放，和 malloc/free 对比
+    void throughput_benchmark() {
+        std::cout << "=== MemoryPool Throughput Benchmark ===" << std::endl;
+        const int rounds = 2000;
+        const int batch = 256;
+        std::vector<size_t> sizes(batch);
+        std::mt19937 rng(42);
+        for(auto& s : sizes) {
+            s = 16 + rng() % 497;
+        }
+
+        auto measure = [&](int threads, auto&& body) {
+            std::vector<std::thread> workers;
+            auto begin = std::chrono::steady_clock::now();
+            for(int t = 0; t < threads; t++) {
+                workers.emplace_back(body);
+            }
+            for(auto& w : workers) {
+                w.join();
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+            return double(ns) / (double(rounds) * batch * threads);
+        };
+
+        std::cout << "threads\tmalloc(ns)\tslab(ns)\tpmr list malloc(ns)\tpmr list slab(ns)" << std::endl;
+        for(int threads : {1, 2, 4}) {
+            double malloc_ns = measure(threads, [&]() {
+                std::vector<void*> ptrs(batch);
+                for(int r = 0; r < rounds; r++) {
+                    for(int i = 0; i < batch; i++) {
+                        ptrs[i] = std::malloc(sizes[i]);
+                        static_cast<char*>(ptrs[i])[0] = 1;
+                    }
+                    for(int i = batch - 1; i >= 0; i--) {
+                        std::free(ptrs[i]);
+                    }
+                }
+            });
+            SlabAllocator slab;
+            double slab_ns = measure(threads, [&]() {
+                std::vector<void*> ptrs(batch);
+                for(int r = 0; r < rounds; r++) {
+                    for(int i = 0; i < batch; i++) {
+                        ptrs[i] = slab.allocate(sizes[i]);
+                        static_cast<char*>(ptrs[i])[0] = 1;
+                    }
+                    for(int i = batch - 1; i >= 0; i--) {
+                        slab.deallocate(ptrs[i], sizes[i]);
+                    }
+                }
+            });
+            auto list_body = [&](std::pmr::memory_resource* resource) {
+                return [&, resource]() {
+                    std::pmr::list<int> list(resource);
+                    for(int r = 0; r < rounds; r++) {
+                        for(int i = 0; i < batch; i++) {
+                            list.push_back(i);
+                        }
+                        list.clear();
+                    }
+                };
+            };
+            double list_malloc_ns = measure(threads, list_body(std::pmr::new_delete_resource()));
+            SlabResource resource;
+            double list_slab_ns = measure(threads, list_body(&resource));
+            std::cout << threads << "\t" << malloc_ns << "\t\t" << slab_ns << "\t\t" << list_malloc_ns << "\t\t\t" << list_slab_ns << std::endl;
+        }
+    }
+
+    /*
+     *  碎片：先分配 20 万个 16~1024 字节的块，随机释放一半，再分配 10 万个 16~256 字节的小块，
+     *  比较仍在使用的字节数和向系统占用的字节数。malloc 的占用从 mallinfo2 取，只在 glibc 上有。
+     *  slab 释放的大块不能拿来满足别的级别的小请求，这种大小分布突变的负载上占用会比 malloc 高
+     */
+    void fragmentation_benchmark() {
+        std::cout << "=== MemoryPool Fragmentation Benchmark ===" << std::endl;
+        const size_t first = 200000;
+        const size_t second = 100000;
+        std::mt19937 rng(7);
+        std::vector<size_t> sizes;
+        for(size_t i = 0; i < first; i++) {
+            sizes.push_back(16 + rng() % 1009);
+        }
+        for(size_t i = 0; i < second; i++) {
+            sizes.push_back(16 + rng() % 241);
+        }
+        std::vector<size_t> order(first);
+        for(size_t i = 0; i < first; i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+
+        // 返回仍在使用的字节数，调用方负责在之后释放 ptrs 里非空的块
+        auto workload = [&](std::vector<void*>& ptrs, auto&& alloc, auto&& dealloc) {
+            ptrs.assign(first + second, nullptr);
+            for(size_t i = 0; i < first; i++) {
+                ptrs[i] = alloc(sizes[i]);
+            }
+            for(size_t i = 0; i < first / 2; i++) {
+                dealloc(ptrs[order[i]], sizes[order[i]]);
+                ptrs[order[i]] = nullptr;
+            }
+            size_t live = 0;
+            for(size_t i = 0; i < first; i++) {
+                live += ptrs[i] ? sizes[i] : 0;
+            }
+            for(size_t i = first; i < first + second; i++) {
+                ptrs[i] = alloc(sizes[i]);
+                live += sizes[i];
+            }
+            return live;
+        };
+        auto report = [](const char* name, size_t live, size_t footprint) {
+            std::cout << name << ": live " << live / 1024 << "KB, footprint " << footprint / 1024 << "KB, utilization "
+                      << (footprint ? 100.0 * live / footprint : 0) << "%" << std::endl;
+        };
+
+        std::vector<void*> ptrs;
+        ptrs.reserve(first + second);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        auto footprint = []() {
+            struct mallinfo2 info = mallinfo2();
+            return info.arena + info.hblkhd;
+        };
+        size_t before = footprint();
+        size_t live = workload(ptrs, [](size_t n) { return std::malloc(n); }, [](void* p, size_t) { std::free(p); });
+        report("malloc", live, footprint() - before);
+        for(void* p : ptrs) {
+            std::free(p);
+        }
+#else
+        std::cout << "malloc: footprint needs glibc >= 2.33" << std::endl;
+#endif
+        SlabAllocator slab;
+        size_t slab_live = workload(ptrs, [&](size_t n) { return slab.allocate(n); }, [&](void* p, size_t n) { slab.deallocate(p, n); });
+        report("slab", slab_live, slab.reserved_bytes());
+        for(size_t i = 0; i < ptrs.size(); i++) {
+            slab.deallocate(ptrs[i], sizes[i]);
+        }
+    }
+
+    void arena_test() {
+        std::cout << "=== MonotonicArena Test ===" << std::endl;
+        static int destroyed = 0;
+        struct Tracked {
+            std::string name;
+            explicit Tracked(std::string n) : name(std::move(n)) {}
+            ~Tracked() { destroyed++; }
+        };
+        struct Point {
+            double x, y;
+        };
+
+        MonotonicArena arena(1024);
+        for(int round = 0; round < 3; round++) {
+            destroyed = 0;
+            for(int i = 0; i < 100; i++) {
+                arena.make<Tracked>("request object " + std::to_string(i));
+                arena.make<Point>(Point{double(i), double(i)});
+            }
+            // pmr 容器直接用 arena 当资源，和对象一起在 reset 时丢弃
+            std::pmr::vector<std::pmr::string> words(&arena);
+            for(int i = 0; i < 100; i++) {
+                words.emplace_back("word number " + std::to_string(i));
+            }
+            size_t used = arena.bytes_used();
+            size_t reserved = arena.bytes_reserved();
+            arena.reset();
+            std::cout << "round " << round << ": used " << used << "B, reserved " << reserved << "B, destructors run "
+                      << destroyed << " (expect 100)" << std::endl;
+        }
+        // 超过块大小的请求单独占一块
+        char* big = static_cast<char*>(arena.allocate_bytes(100000, 64));
+        std::cout << "big allocation aligned: " << (reinterpret_cast<uintptr_t>(big) % 64 == 0 ? "yes" : "no") << std::endl;
+        arena.release();
+        std::cout << "after release, reserved: " << arena.bytes_reserved() << "B (expect 0)" << std::endl;
+    }
+
+    // 模拟一个请求构造几千个小对象后整体丢弃，和逐个 new/delete 对比
+    void arena_benchmark() {
+        std::cout << "=== MonotonicArena Benchmark ===" << std::endl;
+        struct Node {
+            int64_t key;
+            double value;
+            Node* next;
+        };
+        const int requests = 2000;
+        const int objects = 5000;
+
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<Node*> nodes(objects);
+        for(int r = 0; r < requests; r++) {
+            Node* prev = nullptr;
+            for(int i = 0; i < objects; i++) {
+                nodes[i] = prev = new Node{i, i * 0.5, prev};
+            }
+            for(Node* n : nodes) {
+                delete n;
+            }
+        }
+        double heap_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+        MonotonicArena arena;
+        begin = std::chrono::steady_clock::now();
+        for(int r = 0; r < requests; r++) {
+            Node* prev = nullptr;
+            for(int i = 0; i < objects; i++) {
+                prev = arena.make<Node>(Node{i, i * 0.5, prev});
+            }
+            arena.reset();
+        }
+        double arena_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+        std::cout << "new/delete: " << heap_ns / (double(requests) * objects) << " ns per object" << std::endl;
+        std::cout << "arena:      " << arena_ns / (double(requests) * objects) << " ns per object" << std::endl;
+    }
+};
+
+#endif //CPP_LEARN_MEMORYPOOL_H
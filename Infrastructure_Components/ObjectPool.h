@@ -5,42 +5,256 @@
 #include <memory>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <type_traits>
+#include <utility>
+#include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <new>
 
+/*
+ *  独占的池对象句柄，只能移动，析构时把对象还给池子
+ *  和 shared_ptr 不同，不需要控制块，也没有原子引用计数，acquire/release 不分配内存
+ */
+template<typename T>
+class PoolHandle {
+public:
+    using Recycler = void (*)(void* pool, T* obj);
+
+    PoolHandle() = default;
+    // 由池子构造
+    PoolHandle(T* obj, void* pool, Recycler recycler) : obj_(obj), pool_(pool), recycler_(recycler) {}
+
+    PoolHandle(PoolHandle&& other) noexcept : obj_(other.obj_), pool_(other.pool_), recycler_(other.recycler_) {
+        other.obj_ = nullptr;
+    }
+    PoolHandle& operator=(PoolHandle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            obj_ = other.obj_;
+            pool_ = other.pool_;
+            recycler_ = other.recycler_;
+            other.obj_ = nullptr;
+        }
+        return *this;
+    }
+    PoolHandle(const PoolHandle&) = delete;
+    PoolHandle& operator=(const PoolHandle&) = delete;
+
+    ~PoolHandle() {
+        reset();
+    }
+
+    // 提前归还
+    void reset() {
+        if (obj_ != nullptr) {
+            T* obj = obj_;
+            obj_ = nullptr;
+            recycler_(pool_, obj);
+        }
+    }
+
+    T* get() const { return obj_; }
+    T& operator*() const { return *obj_; }
+    T* operator->() const { return obj_; }
+    explicit operator bool() const { return obj_ != nullptr; }
+
+private:
+    T* obj_ = nullptr;
+    void* pool_ = nullptr;
+    Recycler recycler_ = nullptr;
+};
+
+/*
+ *  侵入式引用计数的基类：计数和归还方式存在对象里，PoolRef 只有一个指针大小
+ *  需要共享所有权时让 T 公有继承它，再用池子的 acquireRef 获取
+ */
+class PoolRefCounted {
+protected:
+    PoolRefCounted() = default;
+    // 复制对象内容时不复制计数
+    PoolRefCounted(const PoolRefCounted&) {}
+    PoolRefCounted& operator=(const PoolRefCounted&) { return *this; }
+
+private:
+    template<typename> friend class PoolRef;
+
+    std::atomic<uint32_t> poolRefs_{0};
+    void* pool_ = nullptr;
+    void (*recycler_)(void* pool, PoolRefCounted* obj) = nullptr;
+};
+
+// 可复制的池对象句柄，最后一个副本析构时把对象还给池子
+template<typename T>
+class PoolRef {
+public:
+    using Recycler = void (*)(void* pool, PoolRefCounted* obj);
+
+    PoolRef() = default;
+
+    // 由池子调用：对象刚取出，计数从 1 开始
+    static PoolRef adopt(T* obj, void* pool, Recycler recycler) {
+        static_assert(std::is_base_of<PoolRefCounted, T>::value, "T must derive from PoolRefCounted");
+        PoolRefCounted* base = obj;
+        base->pool_ = pool;
+        base->recycler_ = recycler;
+        base->poolRefs_.store(1, std::memory_order_relaxed);
+        PoolRef ref;
+        ref.obj_ = obj;
+        return ref;
+    }
+
+    PoolRef(const PoolRef& other) : obj_(other.obj_) {
+        if (obj_ != nullptr) {
+            base()->poolRefs_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    PoolRef(PoolRef&& other) noexcept : obj_(other.obj_) {
+        other.obj_ = nullptr;
+    }
+    PoolRef& operator=(PoolRef other) noexcept {
+        std::swap(obj_, other.obj_);
+        return *this;
+    }
+
+    ~PoolRef() {
+        reset();
+    }
+
+    void reset() {
+        if (obj_ != nullptr) {
+            PoolRefCounted* b = base();
+            obj_ = nullptr;
+            if (b->poolRefs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                b->recycler_(b->pool_, b);
+            }
+        }
+    }
+
+    T* get() const { return obj_; }
+    T& operator*() const { return *obj_; }
+    T* operator->() const { return obj_; }
+    explicit operator bool() const { return obj_ != nullptr; }
+
+private:
+    PoolRefCounted* base() const { return obj_; }
+
+    T* obj_ = nullptr;
+};
+
+/*
+ *  加锁的对象池，行为由 Policy 控制：
+ *  池空且未到 maxSize 时按需新建对象，到上限后 acquire 阻塞等待归还，
+ *  tryAcquire/acquireFor 不等或限时等；空闲超过 idleTimeout 的对象会被回收，直到只剩 lowWatermark 个
+ */
 template<typename T>
 class ObjectPool {
 public:
     using ObjectPtr = std::shared_ptr<T>;
+    using Handle = PoolHandle<T>;
+    using Ref = PoolRef<T>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Policy {
+        size_t initialSize = 0;                      // 构造时预先创建的对象数
+        size_t maxSize = SIZE_MAX;                   // 对象总数的硬上限
+        size_t lowWatermark = 0;                     // 收缩时至少保留的对象数
+        std::chrono::milliseconds idleTimeout{0};    // 空闲超过这么久就回收，0 表示不收缩
+        std::function<void(T&)> reset;               // 归还时清理对象状态，代替重新构造
+    };
 
-    explicit ObjectPool(size_t initialSize = 0) : maxSize_(0), count_(0) {
+    // 兼容旧用法：预先创建 initialSize 个，上限也是 initialSize，之后靠 resize 扩容
+    explicit ObjectPool(size_t initialSize = 0) : count_(0) {
+        policy_.maxSize = initialSize;
         if (initialSize > 0) {
             resize(initialSize);
         }
     }
 
-    // 扩容池子
+    explicit ObjectPool(Policy policy) : policy_(std::move(policy)), count_(0) {
+        if (policy_.initialSize > policy_.maxSize) {
+            throw std::invalid_argument("initialSize must not exceed maxSize");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        fill(policy_.initialSize);
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // 只释放池内空闲的对象，使用中的对象必须在池子销毁前归还
+    ~ObjectPool() {
+        for (auto& idle : pool_) {
+            delete idle.obj;
+        }
+    }
+
+    // 扩容池子：补足到 newSize 个对象，上限不足时一并提高
     void resize(size_t newSize) {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (newSize < maxSize_) {
+        if (newSize < count_) {
             throw std::invalid_argument("New size must be greater than current size");
         }
-        for (size_t i = maxSize_; i < newSize; ++i) {
-            pool_.push(new T());
-            ++count_;
-        }
-        maxSize_ = newSize;
+        fill(newSize);
+        policy_.maxSize = std::max(policy_.maxSize, newSize);
         cv_.notify_all(); // 唤醒可能等待的线程
     }
 
-    // 获取对象
+    // 获取对象，池空且已到上限时阻塞
     ObjectPtr acquire() {
+        return makeShared(acquireRaw());
+    }
+
+    // 不等待，拿不到返回空指针
+    ObjectPtr tryAcquire() {
+        T* raw = tryAcquireRaw();
+        return raw ? makeShared(raw) : nullptr;
+    }
+
+    // 最多等待 timeout，超时返回空指针
+    template<typename Rep, typename Period>
+    ObjectPtr acquireFor(const std::chrono::duration<Rep, Period>& timeout) {
         std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [this]() { return !pool_.empty(); });
+        if (!cv_.wait_for(lock, timeout, [this]() { return available(); })) {
+            return nullptr;
+        }
+        return makeShared(take(lock));
+    }
+
+    // 和 acquire 相同，但返回独占句柄，不分配控制块
+    Handle acquireHandle() {
+        return Handle(acquireRaw(), this, &recycleHandle);
+    }
 
-        T* raw = pool_.front();
-        pool_.pop();
-        return makeShared(raw);
+    Handle tryAcquireHandle() {
+        T* raw = tryAcquireRaw();
+        return raw ? Handle(raw, this, &recycleHandle) : Handle();
+    }
+
+    // 侵入式引用计数句柄，T 需要继承 PoolRefCounted
+    Ref acquireRef() {
+        return Ref::adopt(acquireRaw(), this, &recycleRef);
+    }
+
+    // 回收空闲超时的对象；归还时也会顺带检查，长时间没人归还时可以定期调用这个
+    size_t shrink() {
+        std::vector<T*> expired;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            collectIdle(Clock::now(), expired);
+        }
+        for (T* obj : expired) {
+            delete obj;
+        }
+        if (!expired.empty()) {
+            cv_.notify_all();
+        }
+        return expired.size();
     }
 
     // 当前池中可用对象数
@@ -56,21 +270,383 @@ public:
     }
 
 private:
-    // 包装 shared_ptr，释放时自动归还到池子
-    ObjectPtr makeShared(T* raw) {
-        return ObjectPtr(raw, [this](T* ptr) {
-            std::unique_lock<std::mutex> lock(this->mutex_);
-            pool_.push(ptr);
+    struct IdleObject {
+        T* obj;
+        Clock::time_point since;   // 归还时间
+    };
+
+    bool available() const {
+        return !pool_.empty() || count_ < policy_.maxSize;
+    }
+
+    T* acquireRaw() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return available(); });
+        return take(lock);
+    }
+
+    T* tryAcquireRaw() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!available()) {
+            return nullptr;
+        }
+        return take(lock);
+    }
+
+    // 调用方持锁
+    void fill(size_t target) {
+        auto now = stamp();
+        while (count_ < target) {
+            pool_.push_back({new T(), now});
+            ++count_;
+        }
+    }
+
+    // 调用方持锁且 available()；需要新建时先占名额，锁外构造
+    T* take(std::unique_lock<std::mutex>& lock) {
+        if (!pool_.empty()) {
+            // 后进先出：最近归还的对象还在缓存里，也让队头的对象能空闲到被回收
+            T* raw = pool_.back().obj;
+            pool_.pop_back();
+            return raw;
+        }
+        ++count_;
+        lock.unlock();
+        T* raw;
+        try {
+            raw = new T();
+        } catch (...) {
+            lock.lock();
+            --count_;
             lock.unlock();
             cv_.notify_one();
-        });
+            throw;
+        }
+        return raw;
+    }
+
+    // 不收缩时不需要归还时间，省掉一次取时钟
+    Clock::time_point stamp() const {
+        return policy_.idleTimeout.count() > 0 ? Clock::now() : Clock::time_point();
+    }
+
+    // 调用方持锁，队头是空闲最久的
+    void collectIdle(Clock::time_point now, std::vector<T*>& expired) {
+        if (policy_.idleTimeout.count() <= 0) {
+            return;
+        }
+        size_t n = 0;
+        while (count_ > policy_.lowWatermark && n < pool_.size() && now - pool_[n].since >= policy_.idleTimeout) {
+            expired.push_back(pool_[n].obj);
+            ++n;
+            --count_;
+        }
+        if (n > 0) {
+            pool_.erase(pool_.begin(), pool_.begin() + n);
+        }
     }
 
-    size_t maxSize_;                      // 池容量上限
+    void recycle(T* ptr) {
+        if (policy_.reset) {
+            try {
+                policy_.reset(*ptr);
+            } catch (...) {
+                // 清理失败的对象不再复用
+                delete ptr;
+                std::lock_guard<std::mutex> lock(mutex_);
+                --count_;
+                cv_.notify_one();
+                return;
+            }
+        }
+        std::vector<T*> expired;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto now = stamp();
+            pool_.push_back({ptr, now});
+            collectIdle(now, expired);
+        }
+        cv_.notify_one();
+        for (T* obj : expired) {
+            delete obj;
+        }
+    }
+
+    // 包装 shared_ptr，释放时自动归还到池子
+    ObjectPtr makeShared(T* raw) {
+        return ObjectPtr(raw, [this](T* ptr) { recycle(ptr); });
+    }
+
+    static void recycleHandle(void* pool, T* obj) {
+        static_cast<ObjectPool*>(pool)->recycle(obj);
+    }
+
+    static void recycleRef(void* pool, PoolRefCounted* obj) {
+        static_cast<ObjectPool*>(pool)->recycle(static_cast<T*>(obj));
+    }
+
+    Policy policy_;
     size_t count_;                        // 总创建数量
     mutable std::mutex mutex_;
     std::condition_variable cv_;
-    std::queue<T*> pool_;                 // 存裸指针
+    std::vector<IdleObject> pool_;        // 空闲对象，按归还时间排列；取还都在尾部，稳态下不分配内存
+};
+
+/*
+ *  带线程本地缓存的对象池
+ *  每个线程缓存一小批空闲对象，acquire/release 大多只碰本线程的数组，不加锁也没有原子操作；
+ *  本地缓存空了或满了，才和全局空闲链表整批（batchSize 个）交换，全局链表是无锁栈。
+ *  全局也没有对象时加锁新分配一块，所以不会阻塞等待，池子按需增长，对象只构造一次、一直复用。
+ *
+ *  对象和全局链表放在共享的 Core 里，线程本地缓存也持有 Core，
+ *  线程退出时把缓存还给全局；池子先销毁的话，Core 会等最后一个缓存它的线程退出后再释放
+ */
+template<typename T>
+class CachedObjectPool {
+private:
+    // 对象存储在 storage 开头，T* 和 Slot* 可以直接互转
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t index;                        // 全局编号
+        uint32_t next;                         // 批内下一个对象的编号 + 1
+        uint32_t count;                        // 批内对象数，只对批头有效
+        std::atomic<uint32_t> batchNext{0};    // 全局栈里下一批批头的编号 + 1，只对批头有效
+    };
+
+    /*
+     *  第 k 块有 CHUNK_BASE << k 个槽位，编号连续；
+     *  全局栈头用 32 位编号 + 32 位版本号拼成一个 64 位原子量，避免 ABA
+     */
+    static constexpr uint32_t CHUNK_BASE = 64;
+    static constexpr size_t MAX_CHUNKS = 26;
+
+    struct Core {
+        std::atomic<Slot*> chunks[MAX_CHUNKS] = {};
+        std::atomic<uint64_t> head{0};          // 高 32 位版本号，低 32 位批头编号 + 1，0 表示空
+        std::atomic<size_t> total{0};
+        size_t chunkCount = 0;                  // 只在 growMutex 下修改
+        std::mutex growMutex;
+        const size_t batchSize;
+
+        explicit Core(size_t batch) : batchSize(batch) {}
+
+        ~Core() {
+            for(size_t k = 0; k < chunkCount; k++) {
+                Slot* chunk = chunks[k].load(std::memory_order_relaxed);
+                for(size_t i = 0; i < (size_t(CHUNK_BASE) << k); i++) {
+                    object(&chunk[i])->~T();
+                }
+                delete[] chunk;
+            }
+        }
+
+        static T* object(Slot* slot) {
+            return reinterpret_cast<T*>(slot->storage);
+        }
+
+        Slot* slot(uint32_t index) const {
+            uint64_t q = index / CHUNK_BASE + 1;
+            size_t k = 63 - __builtin_clzll(q);
+            uint64_t first = uint64_t(CHUNK_BASE) * ((uint64_t(1) << k) - 1);
+            return chunks[k].load(std::memory_order_acquire) + (index - first);
+        }
+
+        // 把 items 链成一批压到全局栈
+        void pushBatch(T* const* items, size_t n) {
+            Slot* first = reinterpret_cast<Slot*>(items[0]);
+            for(size_t i = 0; i + 1 < n; i++) {
+                reinterpret_cast<Slot*>(items[i])->next = reinterpret_cast<Slot*>(items[i + 1])->index + 1;
+            }
+            first->count = static_cast<uint32_t>(n);
+            uint64_t old = head.load(std::memory_order_relaxed);
+            uint64_t desired;
+            do {
+                first->batchNext.store(static_cast<uint32_t>(old), std::memory_order_relaxed);
+                desired = ((old >> 32) + 1) << 32 | (first->index + 1);
+            } while(!head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        // 弹出一整批追加到 out，全局为空返回 false
+        bool popBatch(std::vector<T*>& out) {
+            uint64_t old = head.load(std::memory_order_acquire);
+            Slot* first;
+            while(true) {
+                uint32_t top = static_cast<uint32_t>(old);
+                if(top == 0) {
+                    return false;
+                }
+                first = slot(top - 1);
+                uint64_t desired = ((old >> 32) + 1) << 32 | first->batchNext.load(std::memory_order_relaxed);
+                if(head.compare_exchange_weak(old, desired, std::memory_order_acquire, std::memory_order_acquire)) {
+                    break;
+                }
+            }
+            Slot* cur = first;
+            for(uint32_t i = 0; i < first->count; i++) {
+                out.push_back(object(cur));
+                if(i + 1 < first->count) {
+                    cur = slot(cur->next - 1);
+                }
+            }
+            return true;
+        }
+
+        // 新分配一块：前 batchSize 个给调用方，其余整批放进全局
+        void grow(std::vector<T*>& out) {
+            std::lock_guard<std::mutex> lock(growMutex);
+            // 等锁期间可能已经有别的线程扩容或归还了
+            if(popBatch(out)) {
+                return;
+            }
+            if(chunkCount == MAX_CHUNKS) {
+                throw std::bad_alloc();
+            }
+            size_t k = chunkCount;
+            size_t n = size_t(CHUNK_BASE) << k;
+            uint32_t base = static_cast<uint32_t>(CHUNK_BASE * ((uint64_t(1) << k) - 1));
+            Slot* chunk = new Slot[n];
+            size_t built = 0;
+            try {
+                for(; built < n; built++) {
+                    new (chunk[built].storage) T();
+                    chunk[built].index = base + static_cast<uint32_t>(built);
+                }
+            } catch(...) {
+                while(built > 0) {
+                    object(&chunk[--built])->~T();
+                }
+                delete[] chunk;
+                throw;
+            }
+            chunks[k].store(chunk, std::memory_order_release);
+            chunkCount++;
+            total.fetch_add(n, std::memory_order_relaxed);
+
+            std::vector<T*> items;
+            items.reserve(n);
+            for(size_t i = 0; i < n; i++) {
+                items.push_back(object(&chunk[i]));
+            }
+            size_t mine = std::min(batchSize, n);
+            out.insert(out.end(), items.end() - mine, items.end());
+            for(size_t i = 0; i + mine < n; i += batchSize) {
+                pushBatch(items.data() + i, std::min(batchSize, n - mine - i));
+            }
+        }
+    };
+
+    struct Cache {
+        std::shared_ptr<Core> core;
+        std::vector<T*> items;
+    };
+
+    // 线程退出时把各个池的缓存还回去
+    struct LocalCaches {
+        std::vector<Cache> caches;
+
+        ~LocalCaches() {
+            for(Cache& c : caches) {
+                flush(c);
+            }
+        }
+
+        static void flush(Cache& c) {
+            for(size_t i = 0; i < c.items.size(); i += c.core->batchSize) {
+                c.core->pushBatch(c.items.data() + i, std::min(c.core->batchSize, c.items.size() - i));
+            }
+            c.items.clear();
+        }
+    };
+
+public:
+    using ObjectPtr = std::shared_ptr<T>;
+
+    explicit CachedObjectPool(size_t initialSize = 0, size_t batchSize = 32)
+        : core_(std::make_shared<Core>(batchSize == 0 ? 1 : batchSize)) {
+        std::vector<T*> items;
+        while(core_->total.load() < initialSize) {
+            items.clear();
+            core_->grow(items);
+            core_->pushBatch(items.data(), items.size());
+        }
+    }
+
+    CachedObjectPool(const CachedObjectPool&) = delete;
+    CachedObjectPool& operator=(const CachedObjectPool&) = delete;
+
+    // 取一个对象，用完必须 release 回同一个池；可以在别的线程 release
+    T* acquireRaw() {
+        Cache& cache = local();
+        if(cache.items.empty() && !core_->popBatch(cache.items)) {
+            core_->grow(cache.items);
+        }
+        T* obj = cache.items.back();
+        cache.items.pop_back();
+        return obj;
+    }
+
+    void release(T* obj) {
+        Cache& cache = local();
+        // 本地缓存满了，把最近还回来的一批交给全局，留下的仍然够下次 acquire 用
+        if(cache.items.size() >= 2 * core_->batchSize) {
+            size_t n = core_->batchSize;
+            core_->pushBatch(cache.items.data() + cache.items.size() - n, n);
+            cache.items.resize(cache.items.size() - n);
+        }
+        cache.items.push_back(obj);
+    }
+
+    // 和 ObjectPool::acquire 一样的用法，析构时自动归还
+    ObjectPtr acquire() {
+        return ObjectPtr(acquireRaw(), [this](T* ptr) { release(ptr); });
+    }
+
+    PoolHandle<T> acquireHandle() {
+        return PoolHandle<T>(acquireRaw(), this, &recycleHandle);
+    }
+
+    // T 需要继承 PoolRefCounted
+    PoolRef<T> acquireRef() {
+        return PoolRef<T>::adopt(acquireRaw(), this, &recycleRef);
+    }
+
+    // 已创建的对象总数（全局 + 各线程缓存 + 使用中）
+    size_t totalCount() const {
+        return core_->total.load(std::memory_order_relaxed);
+    }
+
+private:
+    static void recycleHandle(void* pool, T* obj) {
+        static_cast<CachedObjectPool*>(pool)->release(obj);
+    }
+
+    static void recycleRef(void* pool, PoolRefCounted* obj) {
+        static_cast<CachedObjectPool*>(pool)->release(static_cast<T*>(obj));
+    }
+
+    Cache& local() {
+        static thread_local LocalCaches local;
+        std::vector<Cache>& caches = local.caches;
+        for(Cache& c : caches) {
+            if(c.core == core_) {
+                return c;
+            }
+        }
+        // 顺便清掉已经销毁的池：只剩本线程持有，没有别人会再用它
+        for(size_t i = 0; i < caches.size();) {
+            if(caches[i].core.use_count() == 1) {
+                caches[i] = std::move(caches.back());
+                caches.pop_back();
+            } else {
+                i++;
+            }
+        }
+        caches.push_back(Cache{core_, {}});
+        caches.back().items.reserve(2 * core_->batchSize);
+        return caches.back();
+    }
+
+    std::shared_ptr<Core> core_;
 };
 
 namespace ObjectPool_Test {
@@ -111,6 +687,194 @@ void test() {
 
     std::cout << "after reset all, pool size: " << pool.size() << std::endl;
     std::cout << "total count: " << pool.totalCount() << std::endl;
+
+    // 本地缓存池：跨线程归还，线程退出后缓存回到全局
+    CachedObjectPool<int> cached(0, 4);
+    std::vector<int*> objs;
+    for(int i = 0; i < 100; i++) {
+        objs.push_back(cached.acquireRaw());
+    }
+    std::thread other([&]() {
+        for(int* p : objs) {
+            cached.release(p);
+        }
+    });
+    other.join();
+    std::vector<int*> again;
+    for(int i = 0; i < 100; i++) {
+        again.push_back(cached.acquireRaw());
+    }
+    std::cout << "cached total count: " << cached.totalCount() << " (expect " << 64 + 128 << ")" << std::endl;
+    for(int* p : again) {
+        cached.release(p);
+    }
+
+    // 按需增长、非阻塞获取、归还时清理、空闲收缩
+    ObjectPool<std::vector<int>>::Policy policy;
+    policy.maxSize = 3;
+    policy.lowWatermark = 1;
+    policy.idleTimeout = std::chrono::milliseconds(20);
+    policy.reset = [](std::vector<int>& v) { v.clear(); };
+    ObjectPool<std::vector<int>> elastic(policy);
+    {
+        auto a = elastic.acquire();
+        auto b = elastic.acquire();
+        auto c = elastic.tryAcquire();
+        a->push_back(1);
+        std::cout << "grown to: " << elastic.totalCount() << " (expect 3)" << std::endl;
+        std::cout << "tryAcquire at cap: " << (elastic.tryAcquire() ? "object" : "null") << " (expect null)" << std::endl;
+        auto begin = std::chrono::steady_clock::now();
+        auto d = elastic.acquireFor(std::chrono::milliseconds(10));
+        auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+        std::cout << "acquireFor at cap: " << (d ? "object" : "null") << " after " << waited.count() << "ms (expect null)" << std::endl;
+    }
+    std::cout << "reused object size: " << elastic.acquire()->size() << " (expect 0)" << std::endl;
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    elastic.shrink();
+    std::cout << "after idle shrink, total count: " << elastic.totalCount() << " (expect 1)" << std::endl;
+
+    // 独占句柄只能移动，侵入式句柄可以复制，最后一个副本析构时归还
+    struct Shared : PoolRefCounted {
+        int value = 0;
+    };
+    ObjectPool<Shared> refPool(1);
+    {
+        ObjectPool<Shared>::Handle h = refPool.acquireHandle();
+        ObjectPool<Shared>::Handle moved = std::move(h);
+        moved->value = 42;
+        std::cout << "handle moved: " << (h ? "still set" : "empty") << ", value " << moved->value
+                  << ", pool size " << refPool.size() << " (expect empty, 42, 0)" << std::endl;
+    }
+    {
+        ObjectPool<Shared>::Ref r1 = refPool.acquireRef();
+        ObjectPool<Shared>::Ref r2 = r1;
+        r1.reset();
+        std::cout << "ref copy alive: value " << r2->value << ", pool size " << refPool.size() << " (expect 42, 0)" << std::endl;
+    }
+    std::cout << "after refs dropped, pool size: " << refPool.size() << " (expect 1)" << std::endl;
+}
+
+/*
+ *  多线程 acquire/release：每个线程反复取 hold 个对象再全部归还
+ *  对比原来的加锁池、本地缓存池的 shared_ptr 接口和裸指针接口
+ */
+void benchmark() {
+    std::cout << "=== ObjectPool Benchmark ===" << std::endl;
+    struct Payload {
+        char data[64];
+    };
+    const int rounds = 200000;
+    const int hold = 8;
+
+    auto measure = [&](int threads, auto&& body) {
+        std::vector<std::thread> workers;
+        auto begin = std::chrono::steady_clock::now();
+        for(int t = 0; t < threads; t++) {
+            workers.emplace_back(body);
+        }
+        for(auto& w : workers) {
+            w.join();
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        return double(ns) / (double(rounds) * hold * threads);
+    };
+
+    std::cout << "threads\tlocked(ns)\tcached shared(ns)\tcached raw(ns)" << std::endl;
+    for(int threads : {1, 2, 4, 8}) {
+        ObjectPool<Payload> locked(threads * hold);
+        double lockedNs = measure(threads, [&]() {
+            std::vector<ObjectPool<Payload>::ObjectPtr> objs(hold);
+            for(int r = 0; r < rounds; r++) {
+                for(auto& o : objs) {
+                    o = locked.acquire();
+                }
+                for(auto& o : objs) {
+                    o.reset();
+                }
+            }
+        });
+
+        CachedObjectPool<Payload> cached(threads * hold);
+        double sharedNs = measure(threads, [&]() {
+            std::vector<CachedObjectPool<Payload>::ObjectPtr> objs(hold);
+            for(int r = 0; r < rounds; r++) {
+                for(auto& o : objs) {
+                    o = cached.acquire();
+                }
+                for(auto& o : objs) {
+                    o.reset();
+                }
+            }
+        });
+        double rawNs = measure(threads, [&]() {
+            Payload* objs[hold];
+            for(int r = 0; r < rounds; r++) {
+                for(auto& o : objs) {
+                    o = cached.acquireRaw();
+                }
+                for(auto& o : objs) {
+                    cached.release(o);
+                }
+            }
+        });
+        std::cout << threads << "\t" << lockedNs << "\t\t" << sharedNs << "\t\t\t" << rawNs << std::endl;
+    }
+}
+
+/*
+ *  同一个池子分别用 shared_ptr、独占句柄、侵入式引用计数句柄取还对象
+ *  shared_ptr 每次都要分配控制块，另外两种只剩池子本身的开销
+ */
+void handle_benchmark() {
+    std::cout << "=== ObjectPool Handle Benchmark ===" << std::endl;
+    struct Payload : PoolRefCounted {
+        char data[64];
+    };
+    const int rounds = 200000;
+    const int hold = 8;
+
+    auto measure = [&](int threads, auto&& body) {
+        std::vector<std::thread> workers;
+        auto begin = std::chrono::steady_clock::now();
+        for(int t = 0; t < threads; t++) {
+            workers.emplace_back(body);
+        }
+        for(auto& w : workers) {
+            w.join();
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        return double(ns) / (double(rounds) * hold * threads);
+    };
+    // 每轮取 hold 个对象再全部归还，Ptr 为句柄类型，acquire 为取对象的方式
+    auto cycle = [&](auto acquire) {
+        return [acquire]() mutable {
+            using Ptr = decltype(acquire());
+            std::vector<Ptr> objs(hold);
+            for(int r = 0; r < rounds; r++) {
+                for(auto& o : objs) {
+                    o = acquire();
+                }
+                for(auto& o : objs) {
+                    o.reset();
+                }
+            }
+        };
+    };
+
+    std::cout << "pool\tthreads\tshared_ptr(ns)\thandle(ns)\tref(ns)" << std::endl;
+    for(int threads : {1, 4}) {
+        ObjectPool<Payload> locked(threads * hold);
+        double sharedNs = measure(threads, cycle([&]() { return locked.acquire(); }));
+        double handleNs = measure(threads, cycle([&]() { return locked.acquireHandle(); }));
+        double refNs = measure(threads, cycle([&]() { return locked.acquireRef(); }));
+        std::cout << "locked\t" << threads << "\t" << sharedNs << "\t\t" << handleNs << "\t\t" << refNs << std::endl;
+
+        CachedObjectPool<Payload> cached(threads * hold);
+        sharedNs = measure(threads, cycle([&]() { return cached.acquire(); }));
+        handleNs = measure(threads, cycle([&]() { return cached.acquireHandle(); }));
+        refNs = measure(threads, cycle([&]() { return cached.acquireRef(); }));
+        std::cout << "cached\t" << threads << "\t" << sharedNs << "\t\t" << handleNs << "\t\t" << refNs << std::endl;
+    }
 }
 
 }
@@ -0,0 +1,337 @@
+#ifndef CPP_LEARN_TASKGRAPH_H
+#define CPP_LEARN_TASKGRAPH_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include "ThreadPool.h"
+
+/*
+ *  跑在 ThreadPool 上的任务依赖图（DAG）
+ *  用 precede/succeed 声明边，某个节点的最后一个前驱完成时，由完成它的 worker 直接接着执行，
+ *  不需要任何线程阻塞在 future.get() 上。拓扑建好后可以反复 run，每次只重置计数器
+ */
+class TaskGraph {
+private:
+    struct Node {
+        std::function<void()> work;
+        std::vector<Node*> successors;
+        size_t num_predecessors = 0;
+        size_t id;                         // 在 nodes 中的下标
+        std::atomic<size_t> remaining{0};  // 本轮还没完成的前驱数
+
+        Node(std::function<void()> fn, size_t i) : work(std::move(fn)), id(i) {}
+    };
+
+public:
+    // 节点句柄，只是节点指针的轻量包装，生命周期跟随 TaskGraph
+    class TaskHandle {
+    public:
+        TaskHandle() = default;
+
+        // this 先于 others 执行
+        template<typename... Handles>
+        TaskHandle& precede(Handles&&... others) {
+            (link(node, others.node), ...);
+            return *this;
+        }
+        // others 先于 this 执行
+        template<typename... Handles>
+        TaskHandle& succeed(Handles&&... others) {
+            (link(others.node, node), ...);
+            return *this;
+        }
+    private:
+        friend class TaskGraph;
+        TaskHandle(TaskGraph* g, Node* n) : graph(g), node(n) {}
+
+        void link(Node* from, Node* to) {
+            if(from == nullptr || to == nullptr) {
+                throw std::invalid_argument("TaskHandle is empty");
+            }
+            graph->check_idle();
+            from->successors.push_back(to);
+            to->num_predecessors++;
+            graph->validated = false;
+        }
+
+        TaskGraph* graph = nullptr;
+        Node* node = nullptr;
+    };
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    TaskHandle emplace(std::function<void()> fn) {
+        check_idle();
+        nodes.emplace_back(new Node(std::move(fn), nodes.size()));
+        validated = false;
+        return TaskHandle(this, nodes.back().get());
+    }
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+    /*
+     *  异步执行一轮，返回的 future 在所有节点完成后就绪
+     *  某个节点抛出异常时，后续节点不再执行用户函数，异常通过 future 传给调用方；
+     *  提交到池里失败（比如池已经停止）也一样，没提交出去的节点当作跳过
+     *  同一个图在上一轮结束前不能再次 run
+     */
+    std::future<void> run_async(ThreadPool& pool) {
+        if(running.exchange(true)) {
+            throw std::logic_error("TaskGraph is already running");
+        }
+        try {
+            validate();
+        } catch(...) {
+            running = false;
+            throw;
+        }
+        done = std::promise<void>();
+        std::future<void> result = done.get_future();
+        error = nullptr;
+        failed = false;
+        if(nodes.empty()) {
+            finish();
+            return result;
+        }
+        for(auto& node : nodes) {
+            node->remaining.store(node->num_predecessors, std::memory_order_relaxed);
+        }
+        unfinished.store(nodes.size());
+        // 先收集源点再提交：提交后图就可能跑完，不能再遍历 nodes
+        size_t posted = 0;
+        try {
+            for(; posted < sources.size(); posted++) {
+                Node* source = sources[posted];
+                pool.post([this, &pool, source]() { execute(pool, source); });
+            }
+        } catch(...) {
+            record_error();
+            // sources 只在 validate 里改，图还在跑时不会变，这里遍历是安全的
+            for(size_t i = posted; i < sources.size(); i++) {
+                if(skip(sources[i])) {
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    // 阻塞直到本轮结束，不要在同一个池的 worker 里调用，会占住一个worker
+    void run(ThreadPool& pool) {
+        run_async(pool).get();
+    }
+
+private:
+    void check_idle() const {
+        if(running.load()) {
+            throw std::logic_error("cannot modify a running TaskGraph");
+        }
+    }
+
+    // 拓扑变化后用 Kahn 算法检查有没有环，同时缓存源点；拓扑不变时直接复用
+    void validate() {
+        if(validated) {
+            return;
+        }
+        sources.clear();
+        std::vector<size_t> indegree;
+        std::vector<Node*> ready;
+        indegree.reserve(nodes.size());
+        for(auto& node : nodes) {
+            indegree.push_back(node->num_predecessors);
+            if(node->num_predecessors == 0) {
+                ready.push_back(node.get());
+                sources.push_back(node.get());
+            }
+        }
+        size_t visited = 0;
+        while(!ready.empty()) {
+            Node* node = ready.back();
+            ready.pop_back();
+            visited++;
+            for(Node* next : node->successors) {
+                if(--indegree[next->id] == 0) {
+                    ready.push_back(next);
+                }
+            }
+        }
+        if(visited != nodes.size()) {
+            throw std::logic_error("TaskGraph has a cycle");
+        }
+        validated = true;
+    }
+
+    /*
+     *  执行一个节点，然后把变成就绪的后继分出去：第一个留在当前线程继续跑（省一次入队），
+     *  其余的 post 回池里让别的 worker 拿走
+     */
+    void execute(ThreadPool& pool, Node* node) {
+        while(node != nullptr) {
+            if(!failed.load(std::memory_order_relaxed)) {
+                try {
+                    node->work();
+                } catch(...) {
+                    record_error();
+                }
+            }
+            Node* next = nullptr;
+            for(Node* succ : node->successors) {
+                if(succ->remaining.fetch_sub(1) == 1) {
+                    if(next == nullptr) {
+                        next = succ;
+                    } else {
+                        try {
+                            pool.post([this, &pool, succ]() { execute(pool, succ); });
+                        } catch(...) {
+                            // 当前节点还没计入完成，这里不会走到 finish
+                            record_error();
+                            skip(succ);
+                        }
+                    }
+                }
+            }
+            if(unfinished.fetch_sub(1) == 1) {
+                finish();
+                return;
+            }
+            node = next;
+        }
+    }
+
+    // 在 catch 块里调用，只保留第一个异常
+    void record_error() {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if(!failed.exchange(true)) {
+            error = std::current_exception();
+        }
+    }
+
+    /*
+     *  node 不会再被执行：把它和因此变成就绪的后继都当作完成，只扣计数不跑用户函数。
+     *  本轮因此结束时调用 finish() 并返回 true，之后不能再访问成员
+     */
+    bool skip(Node* node) {
+        std::vector<Node*> pending{node};
+        while(!pending.empty()) {
+            Node* current = pending.back();
+            pending.pop_back();
+            for(Node* succ : current->successors) {
+                if(succ->remaining.fetch_sub(1) == 1) {
+                    pending.push_back(succ);
+                }
+            }
+            if(unfinished.fetch_sub(1) == 1) {
+                finish();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 最后一步才兑现 promise，之后调用方可能立刻销毁图，不能再访问成员
+    void finish() {
+        std::promise<void> p = std::move(done);
+        std::exception_ptr e = error;
+        running = false;
+        if(e) {
+            p.set_exception(e);
+        } else {
+            p.set_value();
+        }
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<Node*> sources;
+    bool validated = false;
+
+    std::atomic<bool> running{false};
+    std::atomic<size_t> unfinished{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::promise<void> done;
+};
+
+namespace TaskGraph_Test {
+    void test() {
+        std::cout << "=== TaskGraph Test ===" << std::endl;
+        ThreadPool pool(4, ThreadPool::Mode::WorkStealing);
+
+        // 菱形依赖：load -> (parse, index) -> report
+        std::mutex out_mutex;
+        std::vector<std::string> order;
+        auto record = [&](const char* name) {
+            std::lock_guard<std::mutex> lock(out_mutex);
+            order.emplace_back(name);
+        };
+
+        TaskGraph graph;
+        auto load = graph.emplace([&] { record("load"); });
+        auto parse = graph.emplace([&] { record("parse"); });
+        auto index = graph.emplace([&] { record("index"); });
+        auto report = graph.emplace([&] { record("report"); });
+        load.precede(parse, index);
+        report.succeed(parse, index);
+
+        // 同一拓扑反复运行
+        for(int round = 0; round < 3; round++) {
+            order.clear();
+            graph.run(pool);
+            std::cout << "round " << round << ":";
+            for(auto& name : order) {
+                std::cout << " " << name;
+            }
+            std::cout << std::endl;
+        }
+
+        // 宽图：1 个源点扇出 1000 个节点再汇聚
+        TaskGraph wide;
+        std::atomic<int> counter{0};
+        auto root = wide.emplace([] {});
+        auto sink = wide.emplace([&] {
+            std::cout << "fan-out done, counter = " << counter.load() << " (expect 1000)" << std::endl;
+        });
+        for(int i = 0; i < 1000; i++) {
+            auto mid = wide.emplace([&] { counter++; });
+            root.precede(mid);
+            mid.precede(sink);
+        }
+        wide.run(pool);
+
+        // 异常通过 future 传回
+        TaskGraph failing;
+        auto bad = failing.emplace([] { throw std::runtime_error("node failed"); });
+        auto after = failing.emplace([] { std::cout << "should not run" << std::endl; });
+        bad.precede(after);
+        try {
+            failing.run(pool);
+        } catch(const std::exception& e) {
+            std::cout << "caught: " << e.what() << std::endl;
+        }
+
+        // 环检测
+        TaskGraph cyclic;
+        auto a = cyclic.emplace([] {});
+        auto b = cyclic.emplace([] {});
+        a.precede(b);
+        b.precede(a);
+        try {
+            cyclic.run(pool);
+        } catch(const std::logic_error& e) {
+            std::cout << "caught: " << e.what() << std::endl;
+        }
+    }
+};
+
+#endif //CPP_LEARN_TASKGRAPH_H
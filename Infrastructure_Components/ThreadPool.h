@@ -2,43 +2,527 @@
 #define CPP_LEARN_THREADPOOL_H
 
 #include <vector>
+#include <array>
 #include <thread>
 #include <condition_variable>
 #include <functional>
 #include <future>
 #include <mutex>
 #include <queue>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <cmath>
+#include <exception>
+#include <string>
+#include <fstream>
+#include <sstream>
 #include <iostream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+ *  内置统计（排队/执行耗时直方图、worker 忙闲、窃取次数、最大队列深度）默认开启，
+ *  编译时定义 THREADPOOL_METRICS=0 可以整体去掉，metrics() 届时返回空快照
+ */
+#ifndef THREADPOOL_METRICS
+#define THREADPOOL_METRICS 1
+#endif
 
 class ThreadPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Mode {
+        GlobalQueue,   // 所有任务共享一个队列
+        WorkStealing   // 每个worker一个双端队列，空闲时去别人那里偷
+    };
+
+    // 优先级通道，数值越小越先执行
+    enum class Priority {
+        High = 0,      // 交互/延迟敏感
+        Normal = 1,
+        Low = 2        // 批量后台任务
+    };
+
+    // 任务超过截止时间后的处理方式
+    enum class DeadlinePolicy {
+        RunFirst,      // 插队到所有任务之前执行
+        Drop           // 直接丢弃，enqueue 得到的 future 会收到 broken_promise
+    };
+
+    struct SubmitOptions {
+        Priority priority = Priority::Normal;
+        Clock::time_point deadline = Clock::time_point::max();  // max 表示没有截止时间
+        DeadlinePolicy on_overdue = DeadlinePolicy::RunFirst;
+
+        SubmitOptions(Priority p = Priority::Normal) : priority(p) {}
+        SubmitOptions(Priority p, Clock::time_point d, DeadlinePolicy policy = DeadlinePolicy::RunFirst)
+            : priority(p), deadline(d), on_overdue(policy) {}
+    };
+
+    /*
+     *  线程池配置，max_threads > min_threads 时为弹性模式：
+     *  队列里最老的任务等待超过 grow_threshold 就加一个线程，多出来的线程空闲超过 idle_timeout 就退出
+     */
+    struct Options {
+        size_t min_threads = 0;  // 0 表示 hardware_concurrency
+        size_t max_threads = 0;  // 0 表示与 min_threads 相同，即固定大小
+        Mode mode = Mode::GlobalQueue;
+        std::chrono::microseconds grow_threshold{1000};
+        std::chrono::milliseconds idle_timeout{10000};
+        unsigned spin_count = 512;  // 睡眠前空转检查新任务的次数，突发流量下避免每个任务都走一次 futex 唤醒；单核机器上不空转
+
+        /*
+         *  绑核：pin_workers 时 worker i 绑到 cpus[i % cpus.size()]，cpus 为空则绑到第 i 个核心
+         *  numa_aware 只对工作窃取模式有效（隐含 pin_workers）：外部线程提交的任务优先放到
+         *  提交线程所在 NUMA 节点的 worker 队列，窃取时也先偷同节点的
+         *  目前只在 Linux 上生效，其他平台忽略这些选项
+         */
+        bool pin_workers = false;
+        std::vector<int> cpus;
+        bool numa_aware = false;
+    };
+
+    // 读取 /sys 下的 NUMA 拓扑，读不到时视为单节点
+    static size_t numa_node_count() {
+        return topology().node_cpus.size();
+    }
+    static const std::vector<int>& numa_node_cpus(size_t node) {
+        return topology().node_cpus.at(node);
+    }
+    static size_t numa_node_of_cpu(int cpu) {
+        const auto& nodes = topology().cpu_node;
+        return (cpu >= 0 && static_cast<size_t>(cpu) < nodes.size()) ? nodes[cpu] : 0;
+    }
+    // 当前线程所在的 NUMA 节点
+    static size_t current_numa_node() {
+#ifdef __linux__
+        return numa_node_of_cpu(sched_getcpu());
+#else
+        return 0;
+#endif
+    }
+
+    // 把当前线程绑到指定核心，失败或不支持时返回 false
+    static bool pin_current_thread(int cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    // 以2的幂为桶边界的耗时直方图
+    struct Histogram {
+        std::vector<uint64_t> counts;   // counts[i] 为耗时落在 (upper_ns[i-1], upper_ns[i]] 的任务数
+        std::vector<double> upper_ns;
+        uint64_t total = 0;
+
+        // 近似分位数，返回所在桶的上界；p=1 即最大值所在的桶
+        double percentile_ns(double p) const {
+            if(total == 0) {
+                return 0;
+            }
+            uint64_t target = std::min(static_cast<uint64_t>(p * total), total - 1);
+            uint64_t seen = 0;
+            for(size_t i = 0; i < counts.size(); i++) {
+                seen += counts[i];
+                if(seen > target) {
+                    return upper_ns[i];
+                }
+            }
+            return upper_ns.empty() ? 0 : upper_ns.back();
+        }
+    };
+
+    struct WorkerMetrics {
+        uint64_t tasks = 0;
+        uint64_t steals = 0;
+        double busy_ratio = 0;  // 执行任务的时间 / 存活时间
+    };
+
+    struct MetricsSnapshot {
+        Histogram queue_wait;   // 入队到开始执行
+        Histogram run_time;     // 执行耗时
+        std::vector<WorkerMetrics> workers;
+        uint64_t steals = 0;
+        size_t max_queue_depth = 0;
+    };
+
+    /*
+     *  只能移动的任务类型，替代 std::function<void()>
+     *  可调用对象不超过 INLINE_SIZE 时直接构造在内部缓冲区里，不走堆分配；
+     *  太大的才退化成 new 出来放指针
+     */
+    class Task {
+    public:
+        static constexpr size_t INLINE_SIZE = 48;
+
+        Task() = default;
+
+        template<typename F, typename Fn = typename std::decay<F>::type,
+                 typename = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+        Task(F&& f) {
+            if constexpr(sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t)
+                         && std::is_nothrow_move_constructible<Fn>::value) {
+                new (storage) Fn(std::forward<F>(f));
+                ops = &inline_ops<Fn>;
+            } else {
+                *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+                ops = &heap_ops<Fn>;
+            }
+        }
+
+        Task(Task&& other) noexcept {
+            move_from(other);
+        }
+        Task& operator=(Task&& other) noexcept {
+            if(this != &other) {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task() {
+            reset();
+        }
+
+        void operator()() {
+            ops->invoke(storage);
+        }
+        explicit operator bool() const {
+            return ops != nullptr;
+        }
+
+    private:
+        struct Ops {
+            void (*invoke)(void*);
+            void (*move)(void* dst, void* src);  // 移动后 src 仍需 destroy
+            void (*destroy)(void*);
+        };
+
+        template<typename Fn>
+        static void inline_invoke(void* p) { (*static_cast<Fn*>(p))(); }
+        template<typename Fn>
+        static void inline_move(void* dst, void* src) { new (dst) Fn(std::move(*static_cast<Fn*>(src))); }
+        template<typename Fn>
+        static void inline_destroy(void* p) { static_cast<Fn*>(p)->~Fn(); }
+
+        template<typename Fn>
+        static void heap_invoke(void* p) { (**static_cast<Fn**>(p))(); }
+        template<typename Fn>
+        static void heap_move(void* dst, void* src) {
+            *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+            *static_cast<Fn**>(src) = nullptr;
+        }
+        template<typename Fn>
+        static void heap_destroy(void* p) { delete *static_cast<Fn**>(p); }
+
+        template<typename Fn>
+        static constexpr Ops inline_ops{&inline_invoke<Fn>, &inline_move<Fn>, &inline_destroy<Fn>};
+        template<typename Fn>
+        static constexpr Ops heap_ops{&heap_invoke<Fn>, &heap_move<Fn>, &heap_destroy<Fn>};
+
+        void move_from(Task& other) {
+            ops = other.ops;
+            if(ops) {
+                ops->move(storage, other.storage);
+                other.reset();
+            }
+        }
+        void reset() {
+            if(ops) {
+                ops->destroy(storage);
+                ops = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+        const Ops* ops = nullptr;
+    };
+
 private:
-    std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    struct QueuedTask {
+        Task task;
+        Clock::time_point enqueued;  // 入队时间，只在弹性模式下记录
+#if THREADPOOL_METRICS
+        uint64_t enqueue_tick = 0;
+#endif
+    };
+
+    /*
+     *  统计用的时间戳：x86 上直接读 TSC，只要几个纳秒，比 steady_clock::now() 便宜得多；
+     *  其他平台退化成 steady_clock 的纳秒数。换算成纳秒放在 metrics() 里做
+     */
+    static uint64_t ticks() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        return __builtin_ia32_rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static constexpr size_t HISTOGRAM_BUCKETS = 48;
+
+    // 每个 worker 一份，只有自己写，所以用 relaxed 的 load+store 代替原子加
+    struct alignas(64) WorkerStats {
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busy_ticks{0};
+        std::atomic<uint64_t> lifetime_ticks{0};  // 之前各次存活的时长之和（弹性模式下槽位会复用）
+        std::atomic<uint64_t> started{0};         // 当前线程的启动时间，0 表示槽位上没有线程
+        std::atomic<uint64_t> wait_hist[HISTOGRAM_BUCKETS] = {};
+        std::atomic<uint64_t> run_hist[HISTOGRAM_BUCKETS] = {};
+
+        static void bump(std::atomic<uint64_t>& counter, uint64_t delta = 1) {
+            counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+        // 第 b 个桶收 (2^b, 2^(b+1)] 个 tick
+        static size_t bucket(uint64_t t) {
+            if(t <= 1) {
+                return 0;
+            }
+#if defined(__GNUC__) || defined(__clang__)
+            size_t b = 63 - __builtin_clzll(t - 1);
+#else
+            size_t b = 0;
+            for(uint64_t v = t - 1; v > 1; v >>= 1) {
+                b++;
+            }
+#endif
+            return b < HISTOGRAM_BUCKETS ? b : HISTOGRAM_BUCKETS - 1;
+        }
+    };
+
+    /*
+     *  环形数组实现的任务队列，容量按2的幂扩容、不收缩
+     *  std::deque 在头尾推进时会反复申请/释放内存块，稳态下这里不会再有任何分配
+     */
+    class TaskRing {
+    public:
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+
+        const QueuedTask& front() const { return buf[head]; }
+
+        void push_back(QueuedTask&& item) {
+            if(count == buf.size()) {
+                grow();
+            }
+            buf[(head + count) & (buf.size() - 1)] = std::move(item);
+            count++;
+        }
+        QueuedTask pop_front() {
+            QueuedTask item = std::move(buf[head]);
+            head = (head + 1) & (buf.size() - 1);
+            count--;
+            return item;
+        }
+        QueuedTask pop_back() {
+            count--;
+            return std::move(buf[(head + count) & (buf.size() - 1)]);
+        }
+    private:
+        void grow() {
+            std::vector<QueuedTask> bigger(buf.empty() ? 64 : buf.size() * 2);
+            for(size_t i = 0; i < count; i++) {
+                bigger[i] = std::move(buf[(head + i) & (buf.size() - 1)]);
+            }
+            buf.swap(bigger);
+            head = 0;
+        }
+
+        std::vector<QueuedTask> buf;
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    struct DeadlineTask {
+        Clock::time_point deadline;
+        uint64_t seq;              // 截止时间相同时按提交顺序
+        bool drop_when_overdue;
+        QueuedTask item;
+
+        // 给 std::push_heap 用，构成按截止时间的最小堆
+        bool operator<(const DeadlineTask& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+        }
+    };
+
+    /*
+     *  一个优先级通道：普通任务 FIFO，带截止时间的任务按截止时间排在堆里（EDF），
+     *  同一通道内先执行带截止时间的
+     */
+    struct Lane {
+        TaskRing fifo;
+        std::vector<DeadlineTask> deadlines;
+        std::atomic<size_t> depth{0};
+    };
+    static constexpr size_t LANE_COUNT = 3;
+
+    /*
+     *  工作窃取模式下每个worker私有的双端队列
+     *  owner 在尾部 push/pop（LIFO，缓存热），小偷从头部偷（FIFO，偷到的往往是大任务）
+     */
+    struct WorkerQueue {
+        TaskRing tasks;
+        std::mutex mutex;
+    };
+
+    // 记录当前线程属于哪个池的哪个worker，外部线程为 nullptr
+    struct WorkerContext {
+        const ThreadPool* pool = nullptr;
+        size_t index = 0;
+    };
+    static WorkerContext& current_worker() {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    // worker 槽位按 max_threads 预先分配，弹性模式下线程在槽位上启动/退出
+    struct WorkerSlot {
+        std::thread thread;
+        std::atomic<bool> active{false};
+        int cpu = -1;                 // 绑定的核心，-1 表示不绑
+        size_t node = 0;              // 所在 NUMA 节点
+        std::vector<size_t> victims;  // 窃取顺序，NUMA 模式下同节点的排在前面
+#if THREADPOOL_METRICS
+        WorkerStats stats;
+#endif
+    };
+
+    struct Topology {
+        std::vector<size_t> cpu_node;             // cpu -> node
+        std::vector<std::vector<int>> node_cpus;  // node -> cpus
+    };
+
+    // 解析 "0-3,8-11" 这种格式的 cpulist
+    static std::vector<int> parse_cpu_list(const std::string& text) {
+        std::vector<int> result;
+        std::stringstream ss(text);
+        std::string item;
+        while(std::getline(ss, item, ',')) {
+            if(item.empty() || item == "\n") {
+                continue;
+            }
+            size_t dash = item.find('-');
+            int lo = std::stoi(item.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(item.substr(dash + 1));
+            for(int c = lo; c <= hi; c++) {
+                result.push_back(c);
+            }
+        }
+        return result;
+    }
+
+    static Topology load_topology() {
+        Topology topo;
+        for(size_t node = 0; ; node++) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string line;
+            if(!in || !std::getline(in, line)) {
+                break;
+            }
+            std::vector<int> cpus = parse_cpu_list(line);
+            for(int cpu : cpus) {
+                if(topo.cpu_node.size() <= static_cast<size_t>(cpu)) {
+                    topo.cpu_node.resize(cpu + 1, 0);
+                }
+                topo.cpu_node[cpu] = node;
+            }
+            topo.node_cpus.push_back(std::move(cpus));
+        }
+        if(topo.node_cpus.empty()) {
+            std::vector<int> cpus;
+            for(unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); c++) {
+                cpus.push_back(static_cast<int>(c));
+            }
+            topo.cpu_node.assign(cpus.size(), 0);
+            topo.node_cpus.push_back(std::move(cpus));
+        }
+        return topo;
+    }
+
+    static const Topology& topology() {
+        static const Topology topo = load_topology();
+        return topo;
+    }
+
+    std::vector<std::unique_ptr<WorkerSlot>> workers;
+    Lane lanes[LANE_COUNT];             // 全局队列，按优先级分通道
+    std::atomic<size_t> queued{0};      // 所有通道中的任务数
+    size_t deadline_count = 0;          // 通道中带截止时间的任务数，受 queue_mutex 保护
+    uint64_t deadline_seq = 0;
+    std::atomic<size_t> dropped{0};     // 因过期被丢弃的任务数
     std::mutex queue_mutex;
     std::condition_variable condition;
-    bool stop = false;
+    std::atomic<bool> stop{false};
+
+    Mode mode;
+    std::vector<std::unique_ptr<WorkerQueue>> local_queues;
+    std::atomic<size_t> pending{0};     // 本地队列+全局通道中尚未取走的任务数
+    std::atomic<size_t> sleeping{0};    // 正在 condition 上等待的worker数
+    std::atomic<size_t> next_queue{0};  // 外部提交时轮询选择队列
+    std::vector<std::vector<size_t>> node_workers;  // NUMA 节点 -> 该节点上的 worker 槽位
+
+    Options options;
+    bool elastic;
+    std::atomic<size_t> live{0};        // 当前存活的worker数
+    std::mutex resize_mutex;            // 保护槽位上线程的启动和回收
+    std::atomic<Clock::rep> last_grow{0};
+
+    std::atomic<size_t> max_depth{0};   // 观察到的最大排队任务数
+    uint64_t created_tick = ticks();    // 用于把 tick 换算成纳秒
+    Clock::time_point created_time = Clock::now();
 public:
-    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency()) {
-        for(size_t i = 0; i < num_threads; i++) {
-            workers.emplace_back([this] {
-                while(true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(queue_mutex);
-                        condition.wait(lock, [this] {
-                            return stop || !tasks.empty();
-                        });
-
-                        if(stop && tasks.empty()) {
-                            return;
-                        }
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency(), Mode m = Mode::GlobalQueue)
+        : ThreadPool(make_options(num_threads, m)) {}
 
-                        task = std::move(tasks.front());
-                        tasks.pop();
-                    }
-                    task();
-                }
-            });
+    explicit ThreadPool(const Options& opts) : mode(opts.mode), options(opts) {
+        if(options.min_threads == 0) {
+            options.min_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        options.max_threads = std::max(options.max_threads, options.min_threads);
+        elastic = options.max_threads > options.min_threads;
+        if(std::thread::hardware_concurrency() <= 1) {
+            options.spin_count = 0;
+        }
+
+        if(mode != Mode::WorkStealing) {
+            options.numa_aware = false;  // 只有一个全局队列，没有就近可言
+        }
+        if(options.numa_aware) {
+            options.pin_workers = true;
+        }
+
+        for(size_t i = 0; i < options.max_threads; i++) {
+            workers.emplace_back(new WorkerSlot());
+            if(mode == Mode::WorkStealing) {
+                local_queues.emplace_back(new WorkerQueue());
+            }
+        }
+        place_workers();
+        std::lock_guard<std::mutex> lock(resize_mutex);
+        for(size_t i = 0; i < options.min_threads; i++) {
+            start_worker(i);
         }
     }
 
@@ -48,8 +532,11 @@ public:
             stop = true;
         }
         condition.notify_all();
-        for(auto& worker : workers) {
-            worker.join();
+        std::lock_guard<std::mutex> lock(resize_mutex);
+        for(auto& slot : workers) {
+            if(slot->thread.joinable()) {
+                slot->thread.join();
+            }
         }
     }
 
@@ -59,25 +546,720 @@ public:
         /*
          *  std::packaged_task用于包装一个函数/可调用对象，并将其执行结果与future绑定
          *  但是要求一个无参数的任务，所以用bind把f和参数列表提前绑定好
-         *  使用shared_ptr是因为任务需要同时存在于任务队列和工作线程
+         *  packaged_task 本身只能移动，直接放进 Task 的内部缓冲区，不再额外包一层 shared_ptr
          */
-        auto task = std::make_shared<std::packaged_task<ReturnType()>>(
+        std::packaged_task<ReturnType()> task(
                 std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
 
-        std::future<ReturnType> res = task->get_future();  // 修改这里
+        std::future<ReturnType> res = task.get_future();
+        submit(Task(std::move(task)));
+        return res;
+    }
+
+    // 指定优先级/截止时间提交，例如 enqueue(ThreadPool::Priority::High, f, args...)
+    template<typename F, typename... Args>
+    auto enqueue(const SubmitOptions& options, F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
+        using ReturnType = decltype(f(args...));
+        std::packaged_task<ReturnType()> task(
+                std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+        std::future<ReturnType> res = task.get_future();
+        submit(Task(std::move(task)), options);
+        return res;
+    }
+
+    /*
+     *  不需要返回值的任务用 post：没有 future 和共享状态，
+     *  小的 lambda 整个存放在 Task 内部，提交过程不触碰分配器
+     *  任务抛出的异常会被 worker 捕获并打印，不会传播给调用方
+     */
+    template<typename F>
+    void post(F&& f) {
+        submit(Task(std::forward<F>(f)));
+    }
+
+    template<typename F>
+    void post(const SubmitOptions& options, F&& f) {
+        submit(Task(std::forward<F>(f)), options);
+    }
+
+    // 当前存活的worker数，弹性模式下会在 [min_threads, max_threads] 之间变化
+    size_t size() const {
+        return live.load();
+    }
+
+    // 某个优先级通道当前排队的任务数；工作窃取模式下普通任务在本地队列里，算在 Normal 通道
+    size_t queue_depth(Priority priority) const {
+        size_t depth = lanes[static_cast<size_t>(priority)].depth.load(std::memory_order_relaxed);
+        if(mode == Mode::WorkStealing && priority == Priority::Normal) {
+            size_t total = pending.load(std::memory_order_relaxed);
+            size_t global = queued.load(std::memory_order_relaxed);
+            depth += total > global ? total - global : 0;
+        }
+        return depth;
+    }
+
+    size_t dropped_count() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    // 汇总各 worker 的统计，只读不清零，可以在任意线程随时调用
+    MetricsSnapshot metrics() const {
+        MetricsSnapshot snap;
+#if THREADPOOL_METRICS
+        uint64_t now_tick = ticks();
+        double elapsed_ns = std::chrono::duration<double, std::nano>(Clock::now() - created_time).count();
+        double ns_per_tick = (now_tick > created_tick && elapsed_ns > 0) ? elapsed_ns / (now_tick - created_tick) : 1.0;
+
+        for(Histogram* h : {&snap.queue_wait, &snap.run_time}) {
+            h->counts.assign(HISTOGRAM_BUCKETS, 0);
+            for(size_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                h->upper_ns.push_back(std::ldexp(1.0, static_cast<int>(b) + 1) * ns_per_tick);
+            }
+        }
+        for(auto& slot : workers) {
+            const WorkerStats& st = slot->stats;
+            WorkerMetrics wm;
+            wm.tasks = st.tasks.load(std::memory_order_relaxed);
+            wm.steals = st.steals.load(std::memory_order_relaxed);
+            uint64_t started = st.started.load(std::memory_order_relaxed);
+            uint64_t alive = st.lifetime_ticks.load(std::memory_order_relaxed)
+                             + (started != 0 && now_tick > started ? now_tick - started : 0);
+            wm.busy_ratio = alive > 0 ? double(st.busy_ticks.load(std::memory_order_relaxed)) / alive : 0;
+            snap.workers.push_back(wm);
+            snap.steals += wm.steals;
+            for(size_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                snap.queue_wait.counts[b] += st.wait_hist[b].load(std::memory_order_relaxed);
+                snap.run_time.counts[b] += st.run_hist[b].load(std::memory_order_relaxed);
+            }
+        }
+        for(Histogram* h : {&snap.queue_wait, &snap.run_time}) {
+            for(uint64_t c : h->counts) {
+                h->total += c;
+            }
+        }
+        snap.max_queue_depth = max_depth.load(std::memory_order_relaxed);
+#endif
+        return snap;
+    }
+
+    /*
+     *  并行循环：把 [begin,end) 切成若干块，fn(i) 对每个下标调用一次
+     *  grain 为每块的下标数，传 0 时按 worker 数自动切分
+     *  调用线程自己也参与抢块，不会阻塞在 future 上；在 worker 里嵌套调用也不会死锁
+     */
+    template<typename Index, typename Fn>
+    void parallel_for(Index begin, Index end, Index grain, Fn&& fn) {
+        if(end <= begin) {
+            return;
+        }
+        size_t n = static_cast<size_t>(end - begin);
+        size_t step = chunk_size(n, static_cast<size_t>(grain));
+        run_chunks((n + step - 1) / step, [&](size_t c) {
+            Index lo = begin + static_cast<Index>(c * step);
+            Index hi = begin + static_cast<Index>(std::min(n, (c + 1) * step));
+            for(Index i = lo; i < hi; ++i) {
+                fn(i);
+            }
+        });
+    }
+
+    /*
+     *  并行归约：每块从 identity 开始用 reduce(acc, map(i)) 累积，
+     *  最后调用线程按块的顺序合并，结果与串行顺序一致（reduce 需满足结合律）
+     */
+    template<typename Index, typename T, typename Map, typename Reduce>
+    T parallel_reduce(Index begin, Index end, Index grain, T identity, Map&& map, Reduce&& reduce) {
+        if(end <= begin) {
+            return identity;
+        }
+        size_t n = static_cast<size_t>(end - begin);
+        size_t step = chunk_size(n, static_cast<size_t>(grain));
+        size_t chunks = (n + step - 1) / step;
+        std::vector<T> partial(chunks, identity);
+        run_chunks(chunks, [&](size_t c) {
+            Index lo = begin + static_cast<Index>(c * step);
+            Index hi = begin + static_cast<Index>(std::min(n, (c + 1) * step));
+            T acc = identity;
+            for(Index i = lo; i < hi; ++i) {
+                acc = reduce(std::move(acc), map(i));
+            }
+            partial[c] = std::move(acc);
+        });
+        T result = std::move(identity);
+        for(auto& p : partial) {
+            result = reduce(std::move(result), std::move(p));
+        }
+        return result;
+    }
+
+    // 并行变换：out[i] = fn(first[i])，要求随机访问迭代器，输出区间需预先分配好
+    template<typename InputIt, typename OutputIt, typename Fn>
+    OutputIt parallel_transform(InputIt first, InputIt last, OutputIt out, size_t grain, Fn&& fn) {
+        size_t n = static_cast<size_t>(std::distance(first, last));
+        parallel_for<size_t>(0, n, grain, [&](size_t i) {
+            out[i] = fn(first[i]);
+        });
+        return out + n;
+    }
+
+private:
+    // 并行块调度的共享状态，晚到的 helper 可能在调用方返回后才运行，所以放在 shared_ptr 里
+    struct ChunkState {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t total = 0;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    size_t chunk_size(size_t n, size_t grain) const {
+        if(grain > 0) {
+            return grain;
+        }
+        // 每个线程大约分到4块，兼顾负载均衡和调度开销
+        size_t target = (size() + 1) * 4;
+        return std::max<size_t>(1, (n + target - 1) / target);
+    }
+
+    /*
+     *  抢块执行，直到没有剩余的块；body 只会在块没被抢完之前被访问，
+     *  所以 helper 拿着 body 的指针是安全的：调用方返回前所有被领走的块都已完成
+     */
+    template<typename Body>
+    static void drain_chunks(ChunkState& state, Body* body) {
+        size_t c;
+        while((c = state.next.fetch_add(1)) < state.total) {
+            if(!state.failed.load(std::memory_order_relaxed)) {
+                try {
+                    (*body)(c);
+                } catch(...) {
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    if(!state.failed.exchange(true)) {
+                        state.error = std::current_exception();
+                    }
+                }
+            }
+            if(state.done.fetch_add(1) + 1 == state.total) {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.finished.notify_all();
+            }
+        }
+    }
+
+    template<typename Body>
+    void run_chunks(size_t chunks, Body&& body) {
+        if(chunks == 1) {
+            body(0);
+            return;
+        }
+        auto state = std::make_shared<ChunkState>();
+        state->total = chunks;
+        auto* body_ptr = &body;
+        size_t helpers = std::min(size(), chunks - 1);
+        try {
+            for(size_t i = 0; i < helpers; i++) {
+                post([state, body_ptr]() { drain_chunks(*state, body_ptr); });
+            }
+        } catch(...) {
+            // 比如池正在停止：已经提交的 helper 还拿着 body_ptr，不能直接抛出退栈，
+            // 记下异常，剩下的块由调用方领完，等所有块结束后再抛
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(!state->failed.exchange(true)) {
+                state->error = std::current_exception();
+            }
+        }
+        drain_chunks(*state, body_ptr);
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->finished.wait(lock, [&state] {
+                return state->done.load() == state->total;
+            });
+        }
+        if(state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    /*
+     *  工作窃取模式下，只有不带截止时间的 Normal 任务进本地队列，
+     *  其余任务都进全局通道，worker 会在本地队列之前/之后检查它们
+     */
+    void submit(Task&& task, const SubmitOptions& options = SubmitOptions()) {
+        QueuedTask item{std::move(task), elastic ? Clock::now() : Clock::time_point()};
+#if THREADPOOL_METRICS
+        item.enqueue_tick = ticks();
+#endif
+        bool has_deadline = options.deadline != Clock::time_point::max();
+        if(mode == Mode::WorkStealing && options.priority == Priority::Normal && !has_deadline) {
+            push_local(std::move(item));
+            return;
+        }
+        Clock::time_point oldest = item.enqueued;
         {
             std::lock_guard<std::mutex> lock(queue_mutex);
             if(stop) {
                 throw std::runtime_error("ThreadPool is stopped");
             }
-            tasks.emplace([task]() { (*task)(); });
+            Lane& lane = lanes[static_cast<size_t>(options.priority)];
+            if(has_deadline) {
+                lane.deadlines.push_back(DeadlineTask{options.deadline, deadline_seq++,
+                                                      options.on_overdue == DeadlinePolicy::Drop, std::move(item)});
+                std::push_heap(lane.deadlines.begin(), lane.deadlines.end());
+                deadline_count++;
+            } else {
+                lane.fifo.push_back(std::move(item));
+                oldest = lane.fifo.front().enqueued;
+            }
+            lane.depth.fetch_add(1, std::memory_order_relaxed);
+            size_t depth = queued.fetch_add(1) + 1;
+            if(mode == Mode::WorkStealing) {
+                depth = pending.fetch_add(1) + 1;
+            }
+            note_depth(depth);
+        }
+        // worker 在 queue_mutex 内登记 sleeping 并检查条件，这里入队后再看 sleeping 不会丢失唤醒
+        if(sleeping.load() > 0) {
+            condition.notify_one();
+        }
+        observe_wait(oldest);
+    }
+
+    /*
+     *  从全局通道取任务，调用方需持有 queue_mutex
+     *  1. 先扫一遍过期任务：Drop 的丢掉，RunFirst 的直接返回
+     *  2. 再按优先级从高到低取；urgent_only 时只看 High 通道
+     */
+    bool pop_lanes(QueuedTask& task, bool urgent_only) {
+        if(deadline_count > 0) {
+            auto now = Clock::now();
+            for(Lane& lane : lanes) {
+                while(!lane.deadlines.empty() && lane.deadlines.front().deadline <= now) {
+                    DeadlineTask overdue = pop_deadline(lane);
+                    if(overdue.drop_when_overdue) {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    task = std::move(overdue.item);
+                    return true;
+                }
+            }
+        }
+        size_t lane_end = urgent_only ? static_cast<size_t>(Priority::Normal) : LANE_COUNT;
+        for(size_t i = 0; i < lane_end; i++) {
+            Lane& lane = lanes[i];
+            if(!lane.deadlines.empty()) {
+                task = std::move(pop_deadline(lane).item);
+                return true;
+            }
+            if(!lane.fifo.empty()) {
+                task = lane.fifo.pop_front();
+                lane_popped(lane);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    DeadlineTask pop_deadline(Lane& lane) {
+        std::pop_heap(lane.deadlines.begin(), lane.deadlines.end());
+        DeadlineTask item = std::move(lane.deadlines.back());
+        lane.deadlines.pop_back();
+        deadline_count--;
+        lane_popped(lane);
+        return item;
+    }
+
+    void lane_popped(Lane& lane) {
+        lane.depth.fetch_sub(1, std::memory_order_relaxed);
+        queued.fetch_sub(1);
+        if(mode == Mode::WorkStealing) {
+            pending.fetch_sub(1);
+        }
+    }
+
+    bool pop_global(QueuedTask& task, bool urgent_only) {
+        if(queued.load() == 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return pop_lanes(task, urgent_only);
+    }
+
+    void note_depth(size_t depth) {
+#if THREADPOOL_METRICS
+        if(depth > max_depth.load(std::memory_order_relaxed)) {
+            size_t seen = max_depth.load(std::memory_order_relaxed);
+            while(depth > seen && !max_depth.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+            }
+        }
+#else
+        (void)depth;
+#endif
+    }
+
+    // 在 worker index 上执行一个任务，顺带记录排队和执行耗时
+    void execute(size_t index, QueuedTask& item) {
+#if THREADPOOL_METRICS
+        WorkerStats& st = workers[index]->stats;
+        uint64_t start = ticks();
+        // 不同核的 TSC 可能有少量偏差，倒挂时按 0 计
+        WorkerStats::bump(st.wait_hist[WorkerStats::bucket(start > item.enqueue_tick ? start - item.enqueue_tick : 0)]);
+        run_task(item.task);
+        uint64_t cost = ticks() - start;
+        WorkerStats::bump(st.run_hist[WorkerStats::bucket(cost)]);
+        WorkerStats::bump(st.busy_ticks, cost);
+        WorkerStats::bump(st.tasks);
+#else
+        (void)index;
+        run_task(item.task);
+#endif
+    }
+
+    static void run_task(Task& task) {
+        try {
+            task();
+        } catch(const std::exception& e) {
+            std::cerr << "ThreadPool task exception : " << e.what() << std::endl;
+        } catch(...) {
+            std::cerr << "ThreadPool task exception : unknown" << std::endl;
+        }
+    }
+
+    // worker线程提交的任务放进自己的队列，外部线程提交的轮询分散到各个队列
+    void push_local(QueuedTask&& item) {
+        WorkerContext& ctx = current_worker();
+        size_t index = (ctx.pool == this) ? ctx.index : pick_queue();
+        Clock::time_point oldest;
+        {
+            std::lock_guard<std::mutex> lock(local_queues[index]->mutex);
+            if(stop) {
+                throw std::runtime_error("ThreadPool is stopped");
+            }
+            local_queues[index]->tasks.push_back(std::move(item));
+            oldest = local_queues[index]->tasks.front().enqueued;
+        }
+        note_depth(pending.fetch_add(1) + 1);
+        /*
+         *  worker 先 sleeping++ 再检查 pending，这里先 pending++ 再检查 sleeping
+         *  两边都是 seq_cst，至少一方能看到对方；看到有人睡眠时先拿一下锁，保证不会丢失唤醒
+         */
+        if(sleeping.load() > 0) {
+            { std::lock_guard<std::mutex> lock(queue_mutex); }
+            condition.notify_one();
+        }
+        observe_wait(oldest);
+    }
+
+    bool pop_local(size_t index, QueuedTask& task) {
+        WorkerQueue& q = *local_queues[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(q.tasks.empty()) {
+            return false;
+        }
+        task = q.tasks.pop_back();
+        pending.fetch_sub(1);
+        return true;
+    }
+
+    bool steal(size_t thief, QueuedTask& task) {
+        for(size_t victim : workers[thief]->victims) {
+            WorkerQueue& q = *local_queues[victim];
+            std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+            if(!lock.owns_lock() || q.tasks.empty()) {
+                continue;
+            }
+            task = q.tasks.pop_front();
+            pending.fetch_sub(1);
+#if THREADPOOL_METRICS
+            WorkerStats::bump(workers[thief]->stats.steals);
+#endif
+            return true;
+        }
+        return false;
+    }
+
+    // 给每个槽位分配核心和节点，并算好窃取顺序
+    void place_workers() {
+        size_t n = workers.size();
+        size_t cpu_count = std::max(1u, std::thread::hardware_concurrency());
+        node_workers.assign(numa_node_count(), {});
+        for(size_t i = 0; i < n; i++) {
+            WorkerSlot& slot = *workers[i];
+            if(options.pin_workers) {
+                slot.cpu = options.cpus.empty() ? static_cast<int>(i % cpu_count)
+                                                : options.cpus[i % options.cpus.size()];
+                slot.node = numa_node_of_cpu(slot.cpu);
+            }
+            node_workers[slot.node].push_back(i);
+        }
+        for(size_t i = 0; i < n; i++) {
+            WorkerSlot& slot = *workers[i];
+            for(size_t k = 1; k < n; k++) {
+                slot.victims.push_back((i + k) % n);
+            }
+            if(options.numa_aware) {
+                std::stable_partition(slot.victims.begin(), slot.victims.end(), [&](size_t v) {
+                    return workers[v]->node == slot.node;
+                });
+            }
+        }
+    }
+
+    /*
+     *  外部线程提交时选一个队列：NUMA 模式下在提交线程所在节点的 worker 里轮询。
+     *  弹性模式缩容后有的槽位没有线程，放进去的任务只能等别人来偷，所以轮到空槽位时改在有线程的槽位里轮询
+     */
+    size_t pick_queue() {
+        size_t ticket = next_queue.fetch_add(1, std::memory_order_relaxed);
+        if(options.numa_aware) {
+            const auto& local = node_workers[current_numa_node() % node_workers.size()];
+            if(!local.empty()) {
+                size_t index = pick_active(local.data(), local.size(), ticket);
+                if(index != SIZE_MAX) {
+                    return index;
+                }
+            }
+        }
+        size_t index = pick_active(nullptr, local_queues.size(), ticket);
+        return index != SIZE_MAX ? index : ticket % local_queues.size();
+    }
+
+    // 在 candidates（nullptr 表示 0..n-1）中按 ticket 轮询；轮到的没有线程时取第 ticket % 活跃数 个活跃槽位，都没有返回 SIZE_MAX
+    size_t pick_active(const size_t* candidates, size_t n, size_t ticket) const {
+        auto at = [candidates](size_t i) { return candidates ? candidates[i] : i; };
+        size_t index = at(ticket % n);
+        if(!elastic || workers[index]->active.load(std::memory_order_relaxed)) {
+            return index;
+        }
+        size_t count = 0;
+        for(size_t i = 0; i < n; i++) {
+            count += workers[at(i)]->active.load(std::memory_order_relaxed);
+        }
+        if(count == 0) {
+            return SIZE_MAX;
+        }
+        size_t skip = ticket % count;
+        for(size_t i = 0; i < n; i++) {
+            if(workers[at(i)]->active.load(std::memory_order_relaxed) && skip-- == 0) {
+                return at(i);
+            }
+        }
+        return SIZE_MAX;  // 扫描期间有线程退休
+    }
+
+    static ThreadPool::Options make_options(size_t num_threads, Mode m) {
+        Options opts;
+        opts.min_threads = num_threads;
+        opts.max_threads = num_threads;
+        opts.mode = m;
+        return opts;
+    }
+
+    // 调用方持有 resize_mutex
+    void start_worker(size_t index) {
+        WorkerSlot& slot = *workers[index];
+        if(slot.thread.joinable()) {
+            slot.thread.join();  // 之前在这个槽位上退休的线程
+        }
+        slot.active = true;
+        live.fetch_add(1);
+        slot.thread = std::thread([this, index] {
+            current_worker() = WorkerContext{this, index};
+            if(workers[index]->cpu >= 0) {
+                pin_current_thread(workers[index]->cpu);
+            }
+#if THREADPOOL_METRICS
+            WorkerStats& st = workers[index]->stats;
+            st.started.store(ticks(), std::memory_order_relaxed);
+#endif
+            if(mode == Mode::WorkStealing) {
+                stealing_loop(index);
+            } else {
+                global_loop(index);
+            }
+#if THREADPOOL_METRICS
+            WorkerStats::bump(st.lifetime_ticks, ticks() - st.started.load(std::memory_order_relaxed));
+            st.started.store(0, std::memory_order_relaxed);
+#endif
+            workers[index]->active = false;
+        });
+    }
+
+    /*
+     *  弹性模式下根据最老任务的等待时间决定是否扩容，同一个 grow_threshold 周期内最多加一个线程
+     *  try_lock 保证提交路径不会被线程创建阻塞，也不会和析构里的 join 死锁
+     */
+    void observe_wait(Clock::time_point enqueued) {
+        if(!elastic || live.load(std::memory_order_relaxed) >= options.max_threads) {
+            return;
+        }
+        auto now = Clock::now();
+        auto threshold = std::chrono::duration_cast<Clock::duration>(options.grow_threshold);
+        if(now - enqueued < threshold) {
+            return;
+        }
+        Clock::rep last = last_grow.load(std::memory_order_relaxed);
+        if(now.time_since_epoch().count() - last < threshold.count()
+           || !last_grow.compare_exchange_strong(last, now.time_since_epoch().count())) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(resize_mutex, std::try_to_lock);
+        if(!lock.owns_lock() || stop || live.load() >= options.max_threads) {
+            return;
+        }
+        for(size_t i = 0; i < workers.size(); i++) {
+            if(!workers[i]->active) {
+                start_worker(i);
+                return;
+            }
+        }
+    }
+
+    // 空闲超时后尝试退休，保证不低于 min_threads
+    bool try_retire() {
+        size_t n = live.load();
+        while(n > options.min_threads) {
+            if(live.compare_exchange_weak(n, n - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void cpu_relax() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // 睡眠前先空转一会儿，期间来了任务就不用再经历一次 park/unpark
+    bool spin_for_work(const std::atomic<size_t>& counter) const {
+        for(unsigned i = 0; i < options.spin_count; i++) {
+            if(counter.load(std::memory_order_relaxed) > 0 || stop.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            cpu_relax();
+        }
+        return false;
+    }
+
+    /*
+     *  在 condition 上等待直到 ready()，调用方持有 queue_mutex
+     *  弹性模式下带空闲超时，返回 false 表示这个 worker 应当退休
+     */
+    template<typename Ready>
+    bool park(std::unique_lock<std::mutex>& lock, Ready ready) {
+        while(!ready()) {
+            sleeping.fetch_add(1);
+            bool woke = true;
+            if(elastic) {
+                woke = condition.wait_for(lock, options.idle_timeout, ready);
+            } else {
+                condition.wait(lock, ready);
+            }
+            sleeping.fetch_sub(1);
+            if(!woke && try_retire()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void global_loop(size_t index) {
+        auto ready = [this] {
+            return stop || queued.load() > 0;
+        };
+        while(true) {
+            QueuedTask item;
+            spin_for_work(queued);
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                if(!park(lock, ready)) {
+                    return;
+                }
+                if(stop && queued.load() == 0) {
+                    live.fetch_sub(1);
+                    return;
+                }
+                if(!pop_lanes(item, false)) {
+                    continue;  // 剩下的都是过期被丢弃的任务
+                }
+            }
+            observe_wait(item.enqueued);
+            execute(index, item);
+        }
+    }
+
+    void stealing_loop(size_t index) {
+        auto ready = [this] {
+            return stop || pending.load() > 0;
+        };
+        while(true) {
+            QueuedTask item;
+            // High 通道和过期任务优先，其次本地队列、偷取，最后才是 Low 等非紧急的全局任务
+            if(pop_global(item, true) || pop_local(index, item) || steal(index, item) || pop_global(item, false)) {
+                observe_wait(item.enqueued);
+                execute(index, item);
+                continue;
+            }
+            // pending>0 说明有任务还没被拿走（可能在被 try_lock 跳过的队列里），让出一下再扫
+            if(pending.load() > 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            if(stop) {
+                live.fetch_sub(1);
+                return;
+            }
+            if(spin_for_work(pending)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if(!park(lock, ready)) {
+                return;
+            }
         }
-        condition.notify_one();
-        return res;
     }
 };
 
+/*
+ *  分配计数：定义 THREADPOOL_COUNT_ALLOCATIONS 后替换全局 operator new/delete，
+ *  用于 ThreadPool_Test::alloc_test 验证稳态下 post 不分配内存。
+ *  替换函数全程序只能有一份，只应在一个测试用的翻译单元里打开
+ */
+#ifdef THREADPOOL_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+namespace ThreadPool_Test {
+    inline std::atomic<size_t> alloc_count{0};
+}
+// 避免 GCC 把替换后的 new/delete 内联进调用点后误报 -Wmismatched-new-delete
+#if defined(__GNUC__)
+#define THREADPOOL_NOINLINE __attribute__((noinline))
+#else
+#define THREADPOOL_NOINLINE
+#endif
+THREADPOOL_NOINLINE void* operator new(size_t n) {
+    ThreadPool_Test::alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+THREADPOOL_NOINLINE void operator delete(void* p) noexcept {
+    std::free(p);
+}
+THREADPOOL_NOINLINE void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+#endif
+
 // 测试代码
 namespace ThreadPool_Test {
     static int add(int a, int b) {
@@ -116,6 +1298,426 @@ namespace ThreadPool_Test {
             std::cout << f.get() << " ";
         }
         std::cout << std::endl;
+
+        // post：没有返回值；捕获超过内部缓冲区的 lambda 会退化为堆上存放
+        std::promise<int> post_done;
+        std::array<int, 32> big{};
+        big[31] = 7;
+        pool.post([&post_done, big]() { post_done.set_value(big[31]); });
+        std::cout << "post with large capture: " << post_done.get_future().get() << std::endl;
+
+        // 工作窃取模式：任务内部再提交子任务，子任务进入当前worker的本地队列
+        ThreadPool ws_pool(4, ThreadPool::Mode::WorkStealing);
+        std::atomic<int> leaf_count{0};
+        std::promise<void> done;
+        std::function<void(int)> spawn = [&](int depth) {
+            if(depth == 0) {
+                if(leaf_count.fetch_add(1) + 1 == (1 << 10)) {
+                    done.set_value();
+                }
+                return;
+            }
+            ws_pool.enqueue(spawn, depth - 1);
+            ws_pool.enqueue(spawn, depth - 1);
+        };
+        ws_pool.enqueue(spawn, 10);
+        done.get_future().wait();
+        std::cout << "work stealing leaves: " << leaf_count.load() << " (expect 1024)" << std::endl;
+
+        // parallel_for / parallel_reduce / parallel_transform
+        std::vector<int> data(10000);
+        pool.parallel_for<size_t>(0, data.size(), 0, [&](size_t i) {
+            data[i] = static_cast<int>(i);
+        });
+        long long sum = pool.parallel_reduce<size_t>(0, data.size(), 256, 0LL,
+                [&](size_t i) { return static_cast<long long>(data[i]); },
+                [](long long a, long long b) { return a + b; });
+        std::cout << "parallel_reduce sum: " << sum << " (expect 49995000)" << std::endl;
+        std::vector<int> doubled(data.size());
+        ws_pool.parallel_transform(data.begin(), data.end(), doubled.begin(), 0, [](int x) { return x % 100 * 2; });
+        std::cout << "parallel_transform doubled[123]: " << doubled[123] << " (expect 46)" << std::endl;
+
+        // 在 worker 中嵌套调用：调用线程参与执行，不会因为等待而占死线程
+        auto nested = pool.enqueue([&pool]() {
+            return pool.parallel_reduce<int>(0, 1000, 10, 0,
+                    [](int i) { return i; }, [](int a, int b) { return a + b; });
+        });
+        std::cout << "nested parallel_reduce: " << nested.get() << " (expect 499500)" << std::endl;
+
+        // 析构停池时 worker 里还在调 parallel_for：helper 提交失败，要等所有块结束后才把异常抛出来
+        std::string stopped_error;
+        {
+            ThreadPool stopping_pool(2);
+            stopping_pool.post([&stopping_pool, &stopped_error]() {
+                // 析构置上 stop 之后 post 才会抛异常
+                while(true) {
+                    try {
+                        stopping_pool.post([] {});
+                    } catch(const std::runtime_error&) {
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                try {
+                    stopping_pool.parallel_for<int>(0, 1000, 10, [](int) {});
+                } catch(const std::exception& e) {
+                    stopped_error = e.what();
+                }
+            });
+        }
+        std::cout << "parallel_for on stopping pool: " << stopped_error << " (expect ThreadPool is stopped)" << std::endl;
+
+        // 优先级通道与截止时间：先用一个任务占住单线程池，再按不同优先级排队
+        std::vector<std::string> ran;
+        {
+            ThreadPool lane_pool(1);
+            std::promise<void> started, gate;
+            std::shared_future<void> gate_future = gate.get_future().share();
+            lane_pool.post([&started, gate_future]() {
+                started.set_value();
+                gate_future.wait();
+            });
+            started.get_future().wait();
+
+            std::mutex ran_mutex;
+            auto record = [&ran, &ran_mutex](const char* name) {
+                return [&ran, &ran_mutex, name]() {
+                    std::lock_guard<std::mutex> lock(ran_mutex);
+                    ran.emplace_back(name);
+                };
+            };
+            auto past = ThreadPool::Clock::now() - std::chrono::milliseconds(1);
+            lane_pool.post(ThreadPool::Priority::Low, record("low"));
+            lane_pool.post(ThreadPool::Priority::Normal, record("normal"));
+            lane_pool.post(ThreadPool::Priority::High, record("high"));
+            lane_pool.post({ThreadPool::Priority::Low, past, ThreadPool::DeadlinePolicy::RunFirst}, record("overdue"));
+            lane_pool.post({ThreadPool::Priority::High, past, ThreadPool::DeadlinePolicy::Drop}, record("dropped"));
+            std::cout << "lane depth high/normal/low: " << lane_pool.queue_depth(ThreadPool::Priority::High) << "/"
+                      << lane_pool.queue_depth(ThreadPool::Priority::Normal) << "/"
+                      << lane_pool.queue_depth(ThreadPool::Priority::Low) << " (expect 2/1/2)" << std::endl;
+            gate.set_value();
+            while(lane_pool.queue_depth(ThreadPool::Priority::Low) > 0) {
+                std::this_thread::yield();
+            }
+            std::cout << "dropped: " << lane_pool.dropped_count() << " (expect 1)" << std::endl;
+        }
+        std::cout << "lane order:";
+        for(auto& name : ran) {
+            std::cout << " " << name;
+        }
+        std::cout << " (expect overdue high normal low)" << std::endl;
+
+        // 弹性模式：任务排队超过阈值时扩容，空闲超时后缩回 min_threads
+        ThreadPool::Options elastic_options;
+        elastic_options.min_threads = 1;
+        elastic_options.max_threads = 4;
+        elastic_options.grow_threshold = std::chrono::milliseconds(2);
+        elastic_options.idle_timeout = std::chrono::milliseconds(100);
+        ThreadPool elastic_pool(elastic_options);
+        std::vector<std::future<void>> slow;
+        for(int i = 0; i < 12; i++) {
+            slow.push_back(elastic_pool.enqueue([]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }));
+            std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        }
+        std::cout << "elastic threads under load: " << elastic_pool.size() << " (expect > 1)" << std::endl;
+        for(auto& f : slow) {
+            f.get();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        std::cout << "elastic threads after idle: " << elastic_pool.size() << " (expect 1)" << std::endl;
+
+        // 弹性工作窃取模式只有 1 个线程时，外部提交都进它自己的队列，不放到没有线程的槽位上等着被偷
+        ThreadPool::Options shrunk_options = elastic_options;
+        shrunk_options.mode = ThreadPool::Mode::WorkStealing;
+        shrunk_options.grow_threshold = std::chrono::seconds(10);
+        ThreadPool shrunk_pool(shrunk_options);
+        std::vector<std::future<void>> small;
+        for(int i = 0; i < 100; i++) {
+            small.push_back(shrunk_pool.enqueue([]() {}));
+        }
+        for(auto& f : small) {
+            f.get();
+        }
+        std::cout << "shrunk work stealing steals: " << shrunk_pool.metrics().steals << " (expect 0)" << std::endl;
+
+        // 绑核 + NUMA 就近队列
+        ThreadPool::Options numa_options;
+        numa_options.mode = ThreadPool::Mode::WorkStealing;
+        numa_options.numa_aware = true;
+        ThreadPool numa_pool(numa_options);
+        auto cpu = numa_pool.enqueue([]() {
+#ifdef __linux__
+            return sched_getcpu();
+#else
+            return -1;
+#endif
+        });
+        std::cout << "numa nodes: " << ThreadPool::numa_node_count()
+                  << ", pinned worker ran on cpu " << cpu.get() << std::endl;
+    }
+
+    // 扩展性基准：1..N 个线程下，两种模式跑同样的递归分裂任务
+    void benchmark() {
+        std::cout << "=== ThreadPool Benchmark ===" << std::endl;
+        const int depth = 16;            // 2^16 个叶子任务
+        const int leaf_work = 2000;      // 每个叶子做一点计算
+        size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        auto run = [&](size_t threads, ThreadPool::Mode mode) {
+            ThreadPool pool(threads, mode);
+            std::atomic<int> leaves{0};
+            std::promise<void> done;
+            std::function<void(int)> spawn = [&](int d) {
+                if(d == 0) {
+                    volatile double x = 0;
+                    for(int i = 0; i < leaf_work; i++) {
+                        x = x + i * 0.5;
+                    }
+                    if(leaves.fetch_add(1) + 1 == (1 << depth)) {
+                        done.set_value();
+                    }
+                    return;
+                }
+                pool.enqueue(spawn, d - 1);
+                pool.enqueue(spawn, d - 1);
+            };
+            auto begin = std::chrono::steady_clock::now();
+            pool.enqueue(spawn, depth);
+            done.get_future().wait();
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        };
+
+        // 1,2,4...，最后一轮保证跑满所有核心
+        std::vector<size_t> thread_counts;
+        for(size_t t = 1; t < max_threads; t *= 2) {
+            thread_counts.push_back(t);
+        }
+        thread_counts.push_back(max_threads);
+
+        std::cout << "threads\tglobal(ms)\tstealing(ms)" << std::endl;
+        for(size_t t : thread_counts) {
+            std::cout << t << "\t" << run(t, ThreadPool::Mode::GlobalQueue)
+                      << "\t\t" << run(t, ThreadPool::Mode::WorkStealing) << std::endl;
+        }
+    }
+
+    /*
+     *  批量任务占满线程池的同时，每毫秒提交一个交互任务，统计交互任务从提交到开始执行的延迟
+     *  对比：全部走同一个 FIFO 通道 vs 批量走 Low、交互走 High
+     */
+    void priority_benchmark() {
+        std::cout << "=== ThreadPool Priority Benchmark ===" << std::endl;
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        const int interactive = 200;
+        const int bulk_per_thread = 6000;
+
+        auto run = [&](ThreadPool::Priority bulk_lane, ThreadPool::Priority interactive_lane) {
+            ThreadPool pool(threads);
+            for(size_t i = 0; i < bulk_per_thread * threads; i++) {
+                pool.post(bulk_lane, []() {
+                    auto until = ThreadPool::Clock::now() + std::chrono::microseconds(50);
+                    while(ThreadPool::Clock::now() < until) {
+                    }
+                });
+            }
+            std::vector<long long> latency_us(interactive);
+            std::atomic<int> finished{0};
+            for(int i = 0; i < interactive; i++) {
+                auto submitted = ThreadPool::Clock::now();
+                pool.post(interactive_lane, [&latency_us, &finished, submitted, i]() {
+                    latency_us[i] = std::chrono::duration_cast<std::chrono::microseconds>(
+                            ThreadPool::Clock::now() - submitted).count();
+                    finished.fetch_add(1);
+                });
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            while(finished.load() < interactive) {
+                std::this_thread::yield();
+            }
+            std::sort(latency_us.begin(), latency_us.end());
+            std::cout << "p50 " << latency_us[interactive / 2] << "us, p99 "
+                      << latency_us[interactive * 99 / 100] << "us" << std::endl;
+        };
+
+        std::cout << "single FIFO lane:   ";
+        run(ThreadPool::Priority::Normal, ThreadPool::Priority::Normal);
+        std::cout << "bulk low / ui high: ";
+        run(ThreadPool::Priority::Low, ThreadPool::Priority::High);
+    }
+
+    // 突发的小任务：一次提交一个、等它执行完再提交下一个，对比睡眠前空转与直接睡眠
+    void spin_benchmark() {
+        std::cout << "=== ThreadPool Spin Benchmark ===" << std::endl;
+        const int rounds = 20000;
+        for(unsigned spin : {0u, 512u}) {
+            ThreadPool::Options opts;
+            opts.min_threads = 2;
+            opts.spin_count = spin;
+            ThreadPool pool(opts);
+            std::atomic<int> done{0};
+            auto begin = ThreadPool::Clock::now();
+            for(int i = 0; i < rounds; i++) {
+                pool.post([&done]() { done.fetch_add(1); });
+                while(done.load() <= i) {
+                    std::this_thread::yield();
+                }
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(ThreadPool::Clock::now() - begin).count();
+            std::cout << "spin_count " << spin << ": " << ns / rounds << " ns per round trip" << std::endl;
+        }
+    }
+
+    /*
+     *  内存带宽受限的负载：每个 NUMA 节点上有一个提交线程，在本节点首次写入若干大缓冲区
+     *  （页面因此分配在本节点），然后提交扫描这些缓冲区的任务。
+     *  对比不绑核的普通工作窃取池和 numa_aware 池的吞吐；单节点机器上两者应当接近
+     */
+    void numa_benchmark() {
+        std::cout << "=== ThreadPool NUMA Benchmark ===" << std::endl;
+        const size_t nodes = ThreadPool::numa_node_count();
+        const size_t words = (16u << 20) / sizeof(uint64_t);  // 每个缓冲区 16MB，远大于缓存
+        const int buffers_per_node = 4;
+        const int passes = 8;
+
+        auto run = [&](bool numa_aware) {
+            ThreadPool::Options opts;
+            opts.mode = ThreadPool::Mode::WorkStealing;
+            opts.numa_aware = numa_aware;
+            ThreadPool pool(opts);
+
+            std::atomic<size_t> prepared{0};
+            std::atomic<bool> go{false};
+            std::atomic<size_t> remaining{nodes * buffers_per_node * passes};
+            std::atomic<uint64_t> sink{0};
+            std::vector<std::thread> submitters;
+            for(size_t node = 0; node < nodes; node++) {
+                submitters.emplace_back([&, node]() {
+                    ThreadPool::pin_current_thread(ThreadPool::numa_node_cpus(node).front());
+                    std::vector<std::vector<uint64_t>> buffers(buffers_per_node, std::vector<uint64_t>(words, 1));
+                    prepared.fetch_add(1);
+                    while(!go.load()) {
+                        std::this_thread::yield();
+                    }
+                    for(int pass = 0; pass < passes; pass++) {
+                        for(auto& buffer : buffers) {
+                            pool.post([&sink, &remaining, data = buffer.data(), words]() {
+                                uint64_t sum = 0;
+                                for(size_t i = 0; i < words; i++) {
+                                    sum += data[i];
+                                }
+                                sink.fetch_add(sum, std::memory_order_relaxed);
+                                remaining.fetch_sub(1);
+                            });
+                        }
+                    }
+                    // 任务跑完之前缓冲区不能释放
+                    while(remaining.load() > 0) {
+                        std::this_thread::yield();
+                    }
+                });
+            }
+            while(prepared.load() < nodes) {
+                std::this_thread::yield();
+            }
+            auto begin = ThreadPool::Clock::now();
+            go = true;
+            for(auto& t : submitters) {
+                t.join();
+            }
+            double seconds = std::chrono::duration<double>(ThreadPool::Clock::now() - begin).count();
+            double bytes = double(nodes * buffers_per_node * passes) * words * sizeof(uint64_t);
+            return bytes / seconds / (1 << 30);
+        };
+
+        std::cout << "nodes: " << nodes << std::endl;
+        std::cout << "unpinned stealing: " << run(false) << " GB/s" << std::endl;
+        std::cout << "numa aware:        " << run(true) << " GB/s" << std::endl;
+    }
+
+    // 稳态下 post 一个小 lambda 的分配次数，需要定义 THREADPOOL_COUNT_ALLOCATIONS
+    void alloc_test() {
+        std::cout << "=== ThreadPool Alloc Test ===" << std::endl;
+#ifdef THREADPOOL_COUNT_ALLOCATIONS
+        const int rounds = 100000;
+        for(ThreadPool::Mode mode : {ThreadPool::Mode::GlobalQueue, ThreadPool::Mode::WorkStealing}) {
+            ThreadPool pool(4, mode);
+            std::atomic<int> finished{0};
+            // 稳态：在途任务数有上限，队列长度不会无限增长
+            const int window = 64;
+            auto run_batch = [&]() {
+                finished.store(0);
+                for(int i = 0; i < rounds; i++) {
+                    while(i - finished.load(std::memory_order_relaxed) >= window) {
+                        std::this_thread::yield();
+                    }
+                    pool.post([&finished, i]() {
+                        volatile int x = i;
+                        (void)x;
+                        finished.fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+                while(finished.load() < rounds) {
+                    std::this_thread::yield();
+                }
+            };
+            for(int i = 0; i < 3; i++) {
+                run_batch();  // 预热：让各个队列扩容到位
+            }
+            size_t before = alloc_count.load();
+            run_batch();
+            size_t after = alloc_count.load();
+            std::cout << (mode == ThreadPool::Mode::GlobalQueue ? "global" : "stealing")
+                      << " allocations per task: " << double(after - before) / rounds << " (expect 0)" << std::endl;
+        }
+#else
+        std::cout << "define THREADPOOL_COUNT_ALLOCATIONS to enable" << std::endl;
+#endif
+    }
+
+    /*
+     *  打印统计快照，并给出空任务的每任务耗时；
+     *  分别用 THREADPOOL_METRICS=1 和 0 编译运行，两者之差就是统计的开销
+     */
+    void metrics_test() {
+        std::cout << "=== ThreadPool Metrics Test (THREADPOOL_METRICS=" << THREADPOOL_METRICS << ") ===" << std::endl;
+        const int tasks = 200000;
+        for(ThreadPool::Mode mode : {ThreadPool::Mode::GlobalQueue, ThreadPool::Mode::WorkStealing}) {
+            ThreadPool pool(4, mode);
+            std::atomic<int> finished{0};
+            auto begin = ThreadPool::Clock::now();
+            for(int i = 0; i < tasks; i++) {
+                pool.post([&finished]() { finished.fetch_add(1, std::memory_order_relaxed); });
+            }
+            while(finished.load() < tasks) {
+                std::this_thread::yield();
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(ThreadPool::Clock::now() - begin).count();
+            // 一个慢任务，让执行耗时直方图有个长尾
+            pool.enqueue([]() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }).get();
+#if THREADPOOL_METRICS
+            // 统计在任务返回之后才记录，等最后一个落账
+            while(pool.metrics().run_time.total < static_cast<uint64_t>(tasks) + 1) {
+                std::this_thread::yield();
+            }
+#endif
+
+            ThreadPool::MetricsSnapshot m = pool.metrics();
+            std::cout << (mode == ThreadPool::Mode::GlobalQueue ? "global" : "stealing")
+                      << ": " << double(ns) / tasks << " ns per task" << std::endl;
+            std::cout << "  queue wait p50/p99: " << m.queue_wait.percentile_ns(0.5) << " / "
+                      << m.queue_wait.percentile_ns(0.99) << " ns" << std::endl;
+            std::cout << "  run time p50/p99/max: " << m.run_time.percentile_ns(0.5) << " / "
+                      << m.run_time.percentile_ns(0.99) << " / " << m.run_time.percentile_ns(1.0) << " ns" << std::endl;
+            std::cout << "  tasks recorded: " << m.run_time.total << " (expect " << tasks + 1 << ")"
+                      << ", steals: " << m.steals << ", max queue depth: " << m.max_queue_depth << std::endl;
+            for(size_t i = 0; i < m.workers.size(); i++) {
+                std::cout << "  worker " << i << ": tasks " << m.workers[i].tasks << ", steals " << m.workers[i].steals
+                          << ", busy " << m.workers[i].busy_ratio * 100 << "%" << std::endl;
+            }
+        }
     }
 };
 
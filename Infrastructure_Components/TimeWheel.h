@@ -6,38 +6,106 @@
 #define CLION_TEST_TIMEWHEEL_H
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <thread>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
+#include <stdexcept>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 
 namespace TimeWheel{
 
-// 时间轮任务节点
-struct TimerTask{
-    uint64_t id;
-    uint64_t expire_time; //到期时间
-    std::function<void()> callback;
-    std::shared_ptr<TimerTask> next;
+// 槽位链表的链接部分，每个槽一个哨兵，节点挂在哨兵组成的环上
+struct TimerLink{
+    TimerLink* prev=nullptr;
+    TimerLink* next=nullptr; // nullptr 表示不在任何槽里
 
-    TimerTask(uint64_t task_id,uint64_t e_time,std::function<void()> cb):id(task_id),expire_time(e_time),callback(std::move(cb)),next(
-            nullptr){}
+    bool linked() const { return next!=nullptr; }
+    void unlink(){
+        prev->next=next;
+        next->prev=prev;
+        prev=next=nullptr;
+    }
 };
 
-// 时间轮实现
+// 批量回调：同一个 tick 里一起到期的同批任务合成一次调用，参数是添加时给的 key
+using BatchCallback = std::function<void(const std::vector<uint64_t>& keys)>;
+using Batch = std::shared_ptr<BatchCallback>;
+
+// 时间轮任务节点，来自节点池，回收后复用
+struct TimerTask : TimerLink{
+    enum : uint64_t { FREE=0, ACTIVE=1, FIRING=2, CANCELLED=3 };
+
+    std::atomic<uint64_t> state{FREE};           // 高位是代数，低 2 位是状态；代数防止旧 id 取消到复用后的节点
+    std::atomic<bool> in_inbox{false};           // 是否在收件箱里，保证同一时刻只被推一次
+    TimerTask* inbox_next=nullptr;
+    std::atomic<uint32_t> free_next{0};          // 空闲栈里下一个节点的编号 + 1
+    uint32_t index=0;
+    uint64_t expire_time=0; //到期时间
+    std::function<void()> callback;
+    Batch batch;                                 // 批量任务所属批次，callback 为空
+    uint64_t key=0;
+};
+
+/*
+ *  分层时间轮，4 层对应毫秒/秒/分钟/小时级别：
+ *  第 0 层 256 个槽，每槽 1 tick（10ms），覆盖 2.56s；第 1~3 层各 64 个槽，每槽分别是 256、256*64、256*64*64 个 tick，
+ *  最高覆盖约 7.7 天，更远的任务先挂在最高层，转到时再重新放置。
+ *  低层转完一圈时，把上一层当前槽的任务按剩余时间重新放到下层（cascade），
+ *  所以插入、取消、到期都是 O(1) 摊还，不会每一圈都把长任务重新扫一遍
+ *
+ *  线程安全：add_timer/cancel_timer 可以在任意线程调用，槽位只由推进 tick 的线程（工作线程或手动 step 的线程）修改。
+ *  新任务和取消请求都压进无锁的 MPSC 收件箱，每个 tick 开始时取出处理；
+ *  槽位是侵入式双向链表，取消时 O(1) 摘除。节点从池里分配，回收后复用，不再每个任务分配 shared_ptr 和哈希表项
+ *
+ *  Linux 上由 timerfd 驱动，不再每 1ms 醒一次：只给下一个非空槽（或下一次 cascade）定时，没有任务时完全不醒。
+ *  可以 start() 用自带的工作线程，也可以把 fd() 注册进自己的 epoll，可读时调用 process()，和 socket 共用一个线程
+ *
+ *  slack_ms 允许任务最多晚 slack 执行：到期 tick 向上对齐到 slack 的整数倍，大量相近的超时落进同一个槽，一次唤醒处理完
+ */
 class TimeWheel{
 public:
-    TimeWheel():wheel(WHEEL_SIZE),current_tick(0),next_task_id(1),running(false){}
+    TimeWheel():current_tick(0),running(false){
+        for(int level=0;level<LEVELS;++level){
+            slots[level]=std::vector<TimerLink>(level==0 ? WHEEL_SIZE : LEVEL_SIZE);
+            for(auto& head:slots[level]){
+                head.prev=head.next=&head;
+            }
+        }
+    }
 
     ~TimeWheel() {
         stop();
+        for(size_t k=0;k<chunk_count;++k){
+            delete[] chunks[k].load();
+        }
+#ifdef __linux__
+        if(timer_fd>=0){
+            ::close(timer_fd);
+        }
+#endif
     }
+    TimeWheel(const TimeWheel&)=delete;
+    TimeWheel& operator=(const TimeWheel&)=delete;
+
     // 启动
     void start(){
         if(!running.load()){
             running.store(true);
+#ifdef __linux__
+            enable_driver();
+#endif
             worker_thread = std::thread(&TimeWheel::worker_loop,this);
             std::cout<<" timewheel start "<<std::endl;
         }
@@ -46,80 +114,143 @@ public:
     void stop(){
         if(running.load()){
             running.store(false);
+#ifdef __linux__
+            wake();
+#endif
             if(worker_thread.joinable()){
                 worker_thread.join();
             }
             std::cout<<" timewheel stop"<<std::endl;
         }
     }
-    // 添加定时任务
-    uint64_t add_timer(uint32_t delay_ms,std::function<void()> callback){
-        uint64_t expire_tick = current_tick + (delay_ms/TICK_MS) ;
-        uint64_t task_id = next_task_id++;
-
-        auto task =std::make_shared<TimerTask>(task_id,expire_tick,std::move(callback));
-
-        //计算槽位
-        int slot = expire_tick % WHEEL_SIZE;
-
-        // 插入对应槽位的任务链表头
-        task->next = wheel[slot];
-        wheel[slot] =task;
-
-        task_map[task_id] = task;
-
-        return task_id;
+    // 添加定时任务，返回的 id 用于取消
+    uint64_t add_timer(uint32_t delay_ms,std::function<void()> callback,uint32_t slack_ms=0){
+        return add(delay_ms,slack_ms,std::move(callback),nullptr,0);
+    }
+    static Batch make_batch(BatchCallback callback){
+        return std::make_shared<BatchCallback>(std::move(callback));
     }
-    //取消定时任务
+    // 添加批量任务，到期时和同批、同 tick 到期的任务一起回调 batch，返回的 id 同样可以取消
+    uint64_t add_batch_timer(const Batch& batch,uint32_t delay_ms,uint64_t key,uint32_t slack_ms=0){
+        return add(delay_ms,slack_ms,nullptr,batch,key);
+    }
+    //取消定时任务：返回 true 表示回调一定不会执行；摘除和回收交给推进 tick 的线程
     bool cancel_timer(uint64_t task_id){
-        auto it=task_map.find(task_id);
-        if(it!=task_map.end()){
-            it->second->callback= nullptr;
-            task_map.erase(it);
-            return true;
+        uint32_t index = static_cast<uint32_t>(task_id);
+        if(index==0 || index>allocated.load(std::memory_order_acquire)){
+            return false;
+        }
+        TimerTask* task = node(index-1);
+        uint64_t expected = (task_id>>32)<<2 | TimerTask::ACTIVE;
+        if(!task->state.compare_exchange_strong(expected,(task_id>>32)<<2 | TimerTask::CANCELLED)){
+            return false;
         }
-        return false;
+        active.fetch_sub(1,std::memory_order_relaxed);
+        // 标记已置位（还在收件箱里，或复查时已被收件箱抢先回收）就不用再推，和 drain_inbox 的回收互斥
+        if(!task->in_inbox.exchange(true)){
+            push_inbox(task);
+        }
+        return true;
     }
-    // 推进一个tick
+    // 推进一个tick，同一时刻只能有一个线程调用
     void step(){
-        int slot = current_tick % WHEEL_SIZE;
-        auto& head = wheel[slot];
-        // 处理所有任务
-        auto current =head;
-        head = nullptr;
-        while(current){
-            auto next=current->next;
-            // 任务到期就执行，否则就重新插回
-            if(current->expire_time<=current_tick){
-                if(current->callback){
-                    try{
-                        current->callback();
-                    }catch(const std::exception& e){
-                        std::cerr<<"Timer task exception : "<<e.what()<<std::endl;
-                    }
-                }
-
-                task_map.erase(current->id);
+        drain_inbox();
+        uint64_t tick = current_tick.load(std::memory_order_relaxed);
+        // 第 0 层转完一圈，从最高的一个“也转完一圈”的层开始，逐层把当前槽放到下层
+        if((tick & (WHEEL_SIZE-1))==0){
+            int top=1;
+            while(top+1<LEVELS && ((tick>>shift(top)) & (LEVEL_SIZE-1))==0){
+                ++top;
             }
-            else{
-                int new_slot = current->expire_time%WHEEL_SIZE;
-                current->next =wheel[new_slot];
-                wheel[new_slot]=current;
+            for(int level=top;level>=1;--level){
+                cascade(level);
             }
-
-            current=next;
         }
 
+        // 第 0 层当前槽里的任务都在这个 tick 到期
+        TimerLink& head = slots[0][tick & (WHEEL_SIZE-1)];
+        while(head.next!=&head){
+            TimerTask* task = static_cast<TimerTask*>(head.next);
+            task->unlink();
+            uint64_t expected = task->state.load();
+            // 已取消的留给收件箱回收，这里只摘下来
+            if((expected&3)!=TimerTask::ACTIVE || !task->state.compare_exchange_strong(expected,(expected&~uint64_t(3)) | TimerTask::FIRING)){
+                continue;
+            }
+            active.fetch_sub(1,std::memory_order_relaxed);
+            if(task->batch){
+                collect(task);
+                recycle(task);
+                continue;
+            }
+            try{
+                task->callback();
+            }catch(const std::exception& e){
+                std::cerr<<"Timer task exception : "<<e.what()<<std::endl;
+            }
+            recycle(task);
+        }
+        // 这个 tick 里到期的批量任务，每个批次回调一次
+        for(auto& due:batch_due){
+            try{
+                (*due.first)(due.second);
+            }catch(const std::exception& e){
+                std::cerr<<"Timer task exception : "<<e.what()<<std::endl;
+            }
+        }
+        batch_due.clear();
 
-        current_tick++;
+        current_tick.store(tick+1,std::memory_order_relaxed);
     }
     uint64_t get_current_time_ms(){
         auto now = std::chrono::steady_clock::now();
         auto duration = now.time_since_epoch();
         return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
     }
+#ifdef __linux__
+    // 给外部事件循环用的 timerfd，可读时调用 process()；不要和 start() 同时用
+    int fd(){
+        enable_driver();
+        std::lock_guard<std::mutex> lock(arm_mutex);
+        rearm();
+        return timer_fd;
+    }
+    // 推进到当前时间并执行到期任务，然后只给下一个需要处理的 tick 定时
+    void process(){
+        uint64_t expirations;
+        ssize_t n = ::read(timer_fd,&expirations,sizeof(expirations)); // 非阻塞，没到期时返回 EAGAIN
+        (void)n;
+        uint64_t due = wall_tick();
+        // 空闲了很久：没有任何任务时直接跳到当前 tick，不用一格一格空转
+        if(active.load()==0 && inbox.load()==nullptr && current_tick.load(std::memory_order_relaxed)<due){
+            current_tick.store(due,std::memory_order_relaxed);
+        }
+        while(current_tick.load(std::memory_order_relaxed)<due){
+            // 中间没有到期也没有要 cascade 的槽，直接跳过去，醒得少了也不用一格一格补
+            if(inbox.load()==nullptr){
+                uint64_t next = next_busy_tick();
+                if(next>current_tick.load(std::memory_order_relaxed)){
+                    current_tick.store(std::min(next,due),std::memory_order_relaxed);
+                    continue;
+                }
+            }
+            step();
+        }
+        std::lock_guard<std::mutex> lock(arm_mutex);
+        rearm();
+    }
+#endif
     // 工作线程函数
     void worker_loop(){
+#ifdef __linux__
+        // 先 poll 后 process，最后再检查 running：stop() 的唤醒即使被 process 里的重新定时覆盖，也会在下一次检查时退出
+        process();
+        while(running.load()){
+            pollfd p{timer_fd,POLLIN,0};
+            ::poll(&p,1,-1);
+            process();
+        }
+#else
         uint64_t last_time =get_current_time_ms();
 
         while(running.load()){
@@ -131,30 +262,336 @@ public:
             for(uint64_t i=0;i<ticks_to_advance;++i){
                 step();
             }
-            last_time = current_time;
+            // 不足一个 tick 的余数留到下次，否则每 1ms 醒一次永远凑不满 TICK_MS
+            last_time += ticks_to_advance*TICK_MS;
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+#endif
     }
     // 获取当前活跃任务数量
     size_t get_active_task_count() const {
-        return task_map.size();
+        return active.load(std::memory_order_relaxed);
     }
 
     // 获取当前tick
     uint64_t get_current_tick() const {
-        return current_tick;
+        return current_tick.load(std::memory_order_relaxed);
     }
 private:
-    static const int WHEEL_SIZE = 256;// 时间轮槽数
+    static const int WHEEL_SIZE = 256;// 第 0 层槽数
+    static const int LEVEL_SIZE = 64; // 第 1~3 层槽数
+    static const int LEVELS = 4;
     static const int TICK_MS = 10; //每个TICK的毫秒数
 
-    std::vector<std::shared_ptr<TimerTask>> wheel; // 时间轮槽位
-    std::unordered_map<uint64_t, std::shared_ptr<TimerTask>> task_map;  // 任务映射
-    uint64_t current_tick;
-    uint64_t next_task_id;
+    // 节点池：第 k 块有 CHUNK_BASE << k 个节点，编号连续，块地址不变
+    static const uint32_t CHUNK_BASE = 256;
+    static const int MAX_CHUNKS = 24;
+
+    // 第 level 层一个槽跨越 2^shift(level) 个 tick
+    static int shift(int level){
+        return level==0 ? 0 : 8+6*(level-1);
+    }
+
+    uint64_t add(uint32_t delay_ms,uint32_t slack_ms,std::function<void()> callback,const Batch& batch,uint64_t key){
+        TimerTask* task = allocate();
+        uint64_t expire = now_tick() + (delay_ms/TICK_MS);
+        uint64_t slack = slack_ms/TICK_MS;
+        if(slack>1){
+            expire = (expire+slack-1)/slack*slack;
+        }
+        task->expire_time = expire;
+        task->callback = std::move(callback);
+        task->batch = batch;
+        task->key = key;
+        uint64_t generation = task->state.load(std::memory_order_relaxed)>>2;
+        task->state.store(generation<<2 | TimerTask::ACTIVE);
+        active.fetch_add(1,std::memory_order_relaxed);
+        task->in_inbox.store(true);
+        push_inbox(task);
+#ifdef __linux__
+        // 入箱后节点可能已经被执行回收，只能用局部的 expire。
+        // 比已经定好的时间早才需要重新定时；和 rearm 里先写 armed_tick 再看收件箱配对，两边至少一边能看到对方
+        if(driven.load(std::memory_order_acquire) && expire<armed_tick.load()){
+            std::lock_guard<std::mutex> lock(arm_mutex);
+            if(expire<armed_tick.load()){
+                armed_tick.store(expire);
+                arm(expire);
+            }
+        }
+#endif
+        return generation<<32 | (uint64_t(task->index)+1);
+    }
+
+    // 新任务的到期时间从哪个 tick 算起：timerfd 驱动时空闲期间不推进 current_tick，要按真实时间算
+    uint64_t now_tick(){
+        uint64_t tick = current_tick.load(std::memory_order_relaxed);
+#ifdef __linux__
+        if(driven.load(std::memory_order_acquire)){
+            uint64_t wall = wall_tick();
+            if(wall>tick){
+                tick=wall;
+            }
+        }
+#endif
+        return tick;
+    }
+
+#ifdef __linux__
+    uint64_t wall_tick(){
+        return static_cast<uint64_t>(static_cast<int64_t>(get_current_time_ms())-base_ms)/TICK_MS;
+    }
+
+    // 第一次用 timerfd 时创建，按已经走过的 tick 数倒推起点，手动 step 过的时间轮接着走
+    void enable_driver(){
+        std::lock_guard<std::mutex> lock(arm_mutex);
+        if(timer_fd>=0){
+            return;
+        }
+        timer_fd = ::timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+        if(timer_fd<0){
+            throw std::runtime_error("TimeWheel: timerfd_create failed");
+        }
+        base_ms = static_cast<int64_t>(get_current_time_ms())-static_cast<int64_t>(current_tick.load()*TICK_MS);
+        driven.store(true,std::memory_order_release);
+    }
+
+    /*
+     *  下一个需要推进的 tick：第 0 层往后一圈里第一个非空槽，和高层第一个要 cascade 的非空槽，取较早的；
+     *  空槽的 cascade 什么也不做，不用为它醒。没有任务返回 UINT64_MAX
+     */
+    uint64_t next_busy_tick() const {
+        uint64_t tick = current_tick.load(std::memory_order_relaxed);
+        if(active.load()==0){
+            return UINT64_MAX;
+        }
+        uint64_t next = UINT64_MAX;
+        for(uint64_t t=tick;t<tick+WHEEL_SIZE;++t){
+            const TimerLink& head = slots[0][t & (WHEEL_SIZE-1)];
+            if(head.next!=&head){
+                next = t;
+                break;
+            }
+        }
+        // 第 level 层的槽在 tick 是 2^shift(level) 的整数倍时 cascade，从不早于当前 tick 的第一个倍数往后找
+        for(int level=1;level<LEVELS;++level){
+            uint64_t unit = uint64_t(1)<<shift(level);
+            uint64_t t = (tick+unit-1) & ~(unit-1);
+            for(int i=0;i<LEVEL_SIZE && t<next;++i,t+=unit){
+                const TimerLink& head = slots[level][(t>>shift(level)) & (LEVEL_SIZE-1)];
+                if(head.next!=&head){
+                    next = t;
+                    break;
+                }
+            }
+        }
+        return next;
+    }
+
+    // 持 arm_mutex 调用，只在推进 tick 的线程：收件箱里还没放进槽的任务也要算上
+    void rearm(){
+        uint64_t next = next_busy_tick();
+        armed_tick.store(next);
+        for(TimerTask* task = inbox.load();task;task=task->inbox_next){
+            if((task->state.load()&3)==TimerTask::ACTIVE && task->expire_time<next){
+                next = task->expire_time;
+            }
+        }
+        armed_tick.store(next);
+        arm(next);
+    }
+
+    // 绝对时间定时到 tick 结束的时刻，那时这个 tick 就可以 step 了；UINT64_MAX 表示停掉
+    void arm(uint64_t tick){
+        itimerspec spec{};
+        if(tick!=UINT64_MAX){
+            int64_t ms = base_ms+static_cast<int64_t>(tick+1)*TICK_MS;
+            spec.it_value.tv_sec = ms/1000;
+            spec.it_value.tv_nsec = ms%1000*1000000;
+            if(spec.it_value.tv_sec<=0 && spec.it_value.tv_nsec<=0){
+                spec.it_value.tv_nsec = 1; // 全 0 会被当成停掉
+            }
+        }
+        ::timerfd_settime(timer_fd,TFD_TIMER_ABSTIME,&spec,nullptr);
+    }
+
+    // 让 timerfd 立刻可读，用来唤醒工作线程
+    void wake(){
+        std::lock_guard<std::mutex> lock(arm_mutex);
+        itimerspec spec{};
+        spec.it_value.tv_nsec = 1;
+        ::timerfd_settime(timer_fd,0,&spec,nullptr);
+    }
+#endif
+
+    TimerTask* node(uint32_t index) const {
+        uint64_t q = index/CHUNK_BASE+1;
+        int k = 63-__builtin_clzll(q);
+        uint64_t first = uint64_t(CHUNK_BASE)*((uint64_t(1)<<k)-1);
+        return chunks[k].load(std::memory_order_acquire)+(index-first);
+    }
+
+    // 从空闲栈取一个节点，栈头是 32 位版本号 + 32 位编号，避免 ABA；空了就加锁扩容
+    TimerTask* allocate(){
+        uint64_t old = free_head.load(std::memory_order_acquire);
+        while(static_cast<uint32_t>(old)!=0){
+            TimerTask* task = node(static_cast<uint32_t>(old)-1);
+            uint64_t desired = ((old>>32)+1)<<32 | task->free_next.load(std::memory_order_relaxed);
+            if(free_head.compare_exchange_weak(old,desired,std::memory_order_acquire,std::memory_order_acquire)){
+                return task;
+            }
+        }
+        std::lock_guard<std::mutex> lock(grow_mutex);
+        if(chunk_count==MAX_CHUNKS){
+            throw std::runtime_error("TimeWheel: too many timers");
+        }
+        size_t n = size_t(CHUNK_BASE)<<chunk_count;
+        uint32_t base = static_cast<uint32_t>(CHUNK_BASE*((uint64_t(1)<<chunk_count)-1));
+        TimerTask* chunk = new TimerTask[n];
+        for(size_t i=0;i<n;++i){
+            chunk[i].index = base+static_cast<uint32_t>(i);
+        }
+        chunks[chunk_count].store(chunk,std::memory_order_release);
+        ++chunk_count;
+        allocated.store(base+static_cast<uint32_t>(n),std::memory_order_release);
+        for(size_t i=1;i<n;++i){
+            push_free(&chunk[i]);
+        }
+        return &chunk[0];
+    }
+
+    void push_free(TimerTask* task){
+        uint64_t old = free_head.load(std::memory_order_relaxed);
+        uint64_t desired;
+        do{
+            task->free_next.store(static_cast<uint32_t>(old),std::memory_order_relaxed);
+            desired = ((old>>32)+1)<<32 | (uint64_t(task->index)+1);
+        }while(!free_head.compare_exchange_weak(old,desired,std::memory_order_release,std::memory_order_relaxed));
+    }
+
+    // 只在推进 tick 的线程调用：析构回调，代数加一后放回空闲栈
+    void recycle(TimerTask* task){
+        task->callback = nullptr;
+        task->batch.reset();
+        uint64_t generation = (task->state.load()>>2)+1;
+        task->state.store(generation<<2 | TimerTask::FREE);
+        push_free(task);
+    }
+
+    void push_inbox(TimerTask* task){
+        TimerTask* old = inbox.load(std::memory_order_relaxed);
+        do{
+            task->inbox_next = old;
+        }while(!inbox.compare_exchange_weak(old,task)); // 顺序一致：和 rearm 里的 armed_tick/收件箱检查配对
+    }
+
+    // 取出收件箱：新任务放进槽位，已取消的摘除并回收
+    void drain_inbox(){
+        TimerTask* list = inbox.exchange(nullptr,std::memory_order_acquire);
+        // 收件箱是栈，反转成提交顺序
+        TimerTask* ordered = nullptr;
+        while(list){
+            TimerTask* next = list->inbox_next;
+            list->inbox_next = ordered;
+            ordered = list;
+            list = next;
+        }
+        while(ordered){
+            TimerTask* task = ordered;
+            ordered = task->inbox_next;
+            uint64_t st = task->state.load();
+            if((st&3)==TimerTask::ACTIVE){
+                // 先清标记再复查状态：之后的取消会重新推进收件箱，之前的取消复查时一定能看到
+                task->in_inbox.store(false);
+                st = task->state.load();
+                if((st&3)==TimerTask::ACTIVE){
+                    if(!task->linked()){
+                        place(task);
+                    }
+                    continue;
+                }
+                // 复查时已被取消：和取消方抢标记，抢到的负责回收，另一方不再推
+                if((st&3)!=TimerTask::CANCELLED || task->in_inbox.exchange(true)){
+                    continue;
+                }
+            }else if((st&3)!=TimerTask::CANCELLED){
+                continue;
+            }
+            // 回收时不清标记：取消方看到还在收件箱就不会再推，否则节点复用后会在收件箱里出现两次
+            if(task->linked()){
+                task->unlink();
+            }
+            recycle(task);
+        }
+    }
+
+    // 按批次归并 key，批次一般只有几个，线性查找就够了
+    void collect(TimerTask* task){
+        for(auto& due:batch_due){
+            if(due.first==task->batch){
+                due.second.push_back(task->key);
+                return;
+            }
+        }
+        batch_due.emplace_back(task->batch,std::vector<uint64_t>{task->key});
+    }
+
+    // 按剩余 tick 数选层，槽号取到期 tick 在该层的对应位
+    void place(TimerTask* task){
+        uint64_t tick = current_tick.load(std::memory_order_relaxed);
+        uint64_t expire = task->expire_time<tick ? tick : task->expire_time;
+        uint64_t delta = expire-tick;
+        int level=0;
+        while(level+1<LEVELS && delta>=(uint64_t(1)<<shift(level+1))){
+            ++level;
+        }
+        if(level==LEVELS-1 && delta>=(uint64_t(1)<<(shift(LEVELS-1)+6))){
+            // 超出最大范围，先挂在最高层最远的槽，转到时再重新放置
+            expire = tick+(uint64_t(1)<<(shift(LEVELS-1)+6))-1;
+        }
+        uint64_t mask = level==0 ? WHEEL_SIZE-1 : LEVEL_SIZE-1;
+        TimerLink& head = slots[level][(expire>>shift(level)) & mask];
+        task->prev = head.prev;
+        task->next = &head;
+        head.prev->next = task;
+        head.prev = task;
+    }
+
+    // 把第 level 层当前槽的任务按剩余时间重新放置，已取消的只摘下来，留给收件箱回收
+    void cascade(int level){
+        uint64_t tick = current_tick.load(std::memory_order_relaxed);
+        TimerLink& head = slots[level][(tick>>shift(level)) & (LEVEL_SIZE-1)];
+        while(head.next!=&head){
+            TimerTask* task = static_cast<TimerTask*>(head.next);
+            task->unlink();
+            if((task->state.load()&3)==TimerTask::ACTIVE){
+                place(task);
+            }
+        }
+    }
+
+    std::vector<TimerLink> slots[LEVELS]; // 各层槽位的哨兵
+    std::atomic<uint64_t> current_tick;
+    std::atomic<size_t> active{0};
+    std::atomic<TimerTask*> inbox{nullptr};
+    std::vector<std::pair<Batch,std::vector<uint64_t>>> batch_due; // 只在推进 tick 的线程使用
+
+    std::atomic<TimerTask*> chunks[MAX_CHUNKS] = {};
+    std::atomic<uint32_t> allocated{0};   // 已分配的节点数
+    size_t chunk_count = 0;               // 只在 grow_mutex 下修改
+    std::mutex grow_mutex;
+    std::atomic<uint64_t> free_head{0};
+
     std::atomic<bool> running; // 运行状态
     std::thread worker_thread; // 工作线程
 
+#ifdef __linux__
+    int timer_fd = -1;
+    int64_t base_ms = 0;                            // tick 0 开始的时刻
+    std::atomic<bool> driven{false};                // 是否由 timerfd 驱动
+    std::atomic<uint64_t> armed_tick{UINT64_MAX};   // timerfd 当前定在哪个 tick
+    std::mutex arm_mutex;
+#endif
+
 
 };
 
@@ -163,4 +600,285 @@ private:
 }
 
 
+namespace TimeWheel_Test{
+    void test(){
+        std::cout<<"=== TimeWheel Test ==="<<std::endl;
+        TimeWheel::TimeWheel wheel;
+        // 不启动工作线程，手动 step，记录每个任务在第几个 tick 触发
+        std::vector<std::pair<const char*,uint64_t>> fired;
+        auto record=[&](const char* name){
+            return [&fired,&wheel,name](){ fired.emplace_back(name,wheel.get_current_tick()); };
+        };
+        wheel.add_timer(50,record("50ms"));
+        wheel.add_timer(5000,record("5s"));
+        wheel.add_timer(600000,record("10min"));
+        uint64_t cancelled = wheel.add_timer(3000,record("cancelled"));
+        wheel.cancel_timer(cancelled);
+        for(int i=0;i<60001;++i){
+            wheel.step();
+        }
+        for(auto& f:fired){
+            std::cout<<f.first<<" fired at tick "<<f.second<<std::endl;
+        }
+        std::cout<<"(expect 50ms@5, 5s@500, 10min@60000, no cancelled), active: "<<wheel.get_active_task_count()<<std::endl;
+
+        // 多个线程一边加一边取消，工作线程同时在跑：取消成功的一定不执行，其余的都会执行
+        std::atomic<int> fired_count{0};
+        std::atomic<int> cancelled_count{0};
+        const int per_thread=20000;
+        wheel.start();
+        std::vector<std::thread> threads;
+        for(int t=0;t<4;++t){
+            threads.emplace_back([&](){
+                for(int i=0;i<per_thread;++i){
+                    uint64_t id=wheel.add_timer(i%50,[&fired_count](){ fired_count++; });
+                    if(i%2==0 && wheel.cancel_timer(id)){
+                        cancelled_count++;
+                    }
+                }
+            });
+        }
+        for(auto& t:threads){
+            t.join();
+        }
+        while(wheel.get_active_task_count()>0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        wheel.stop();
+        std::cout<<"fired + cancelled: "<<fired_count.load()+cancelled_count.load()<<" (expect "<<4*per_thread<<")"<<std::endl;
+        std::cout<<"stale cancel: "<<(wheel.cancel_timer(cancelled) ? "true" : "false")<<" (expect false)"<<std::endl;
+    }
+
+    /*
+     *  回归：立即到期的任务加完马上取消，同时另一个线程不停 step。
+     *  取消和收件箱回收撞在一起时，节点曾被回收后又推进收件箱，复用后在收件箱里出现两次，链表成环，step 卡死
+     */
+    void add_cancel_stress_test(){
+        std::cout<<"=== TimeWheel Add/Cancel Stress Test ==="<<std::endl;
+        TimeWheel::TimeWheel wheel;
+        const int threads=4;
+        const int per_thread=50000;
+        std::atomic<int> fired{0};
+        std::atomic<int> cancelled{0};
+        std::atomic<int> adders_left{threads};
+        std::atomic<uint64_t> steps{0};
+        std::thread stepper([&](){
+            while(adders_left.load()>0 || wheel.get_active_task_count()>0){
+                wheel.step();
+                steps++;
+            }
+        });
+        std::vector<std::thread> adders;
+        for(int t=0;t<threads;++t){
+            adders.emplace_back([&](){
+                for(int i=0;i<per_thread;++i){
+                    uint64_t id=wheel.add_timer(0,[&fired](){ fired++; });
+                    if(wheel.cancel_timer(id)){
+                        cancelled++;
+                    }
+                }
+                adders_left--;
+            });
+        }
+        for(auto& a:adders){
+            a.join();
+        }
+        // step 卡死时计数不再增长，没法 join，只能直接报错退出
+        uint64_t last=steps.load();
+        for(int i=0;i<50 && adders_left.load()==0 && wheel.get_active_task_count()>0;++i){
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if(steps.load()==last){
+                std::cerr<<"step() stalled: inbox livelock"<<std::endl;
+                std::abort();
+            }
+            last=steps.load();
+        }
+        stepper.join();
+        std::cout<<"fired + cancelled: "<<fired.load()+cancelled.load()<<" (expect "<<threads*per_thread<<"), steps "<<steps.load()<<std::endl;
+    }
+
+#ifdef __linux__
+    // 时间轮的 timerfd 和一个 pipe 放进同一个 epoll：定时器和“socket”由一个线程处理，空闲时不醒
+    void epoll_test(){
+        std::cout<<"=== TimeWheel epoll Test ==="<<std::endl;
+        TimeWheel::TimeWheel wheel;
+        int pipe_fds[2];
+        if(::pipe(pipe_fds)!=0){
+            return;
+        }
+        int ep = ::epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wheel.fd();
+        ::epoll_ctl(ep,EPOLL_CTL_ADD,ev.data.fd,&ev);
+        ev.data.fd = pipe_fds[0];
+        ::epoll_ctl(ep,EPOLL_CTL_ADD,pipe_fds[0],&ev);
+
+        auto begin = std::chrono::steady_clock::now();
+        auto elapsed_ms=[&begin](){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-begin).count();
+        };
+        int fired=0;
+        for(uint32_t delay:{30,100,250}){
+            wheel.add_timer(delay,[&fired,&elapsed_ms,delay](){
+                ++fired;
+                std::cout<<delay<<"ms timer fired at "<<elapsed_ms()<<"ms"<<std::endl;
+            });
+        }
+        wheel.add_timer(60000,[](){}); // 远处的任务只会在 cascade 时醒
+        std::thread writer([&pipe_fds](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+            char c='x';
+            ssize_t n = ::write(pipe_fds[1],&c,1);
+            (void)n;
+        });
+
+        int wakeups=0;
+        bool got_pipe=false;
+        while(fired<3 || !got_pipe){
+            epoll_event events[4];
+            int n = ::epoll_wait(ep,events,4,-1);
+            ++wakeups;
+            for(int i=0;i<n;++i){
+                if(events[i].data.fd==pipe_fds[0]){
+                    char c;
+                    ssize_t r = ::read(pipe_fds[0],&c,1);
+                    (void)r;
+                    got_pipe=true;
+                    std::cout<<"pipe readable at "<<elapsed_ms()<<"ms"<<std::endl;
+                }else{
+                    wheel.process();
+                }
+            }
+        }
+        writer.join();
+        // 只剩一个 60s 的任务，它所在的高层槽要快到期时才 cascade，接下来 1 秒里不该醒
+        int idle_wakeups=0;
+        auto idle_end = std::chrono::steady_clock::now()+std::chrono::seconds(1);
+        while(std::chrono::steady_clock::now()<idle_end){
+            epoll_event events[4];
+            int n = ::epoll_wait(ep,events,4,100);
+            for(int i=0;i<n;++i){
+                ++idle_wakeups;
+                wheel.process();
+            }
+        }
+        std::cout<<"wakeups for 3 timers + 1 pipe event: "<<wakeups<<", idle wakeups in 1s: "<<idle_wakeups
+                 <<" (expect 0; a 1ms sleep loop would wake ~"<<elapsed_ms()<<" times)"<<std::endl;
+        ::close(ep);
+        ::close(pipe_fds[0]);
+        ::close(pipe_fds[1]);
+    }
+#endif
+
+#ifdef __linux__
+    // 1 万个 100~300ms 的超时由 epoll 驱动：不带 slack、带 50ms slack、带 slack 的批量任务，比较唤醒次数和回调次数
+    void coalesce_test(){
+        std::cout<<"=== TimeWheel Coalesce Test ==="<<std::endl;
+        const int timers=10000;
+        const char* names[]={"no slack","50ms slack","50ms slack + batch"};
+        for(int mode=0;mode<3;++mode){
+            TimeWheel::TimeWheel wheel;
+            int ep = ::epoll_create1(EPOLL_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = wheel.fd();
+            ::epoll_ctl(ep,EPOLL_CTL_ADD,ev.data.fd,&ev);
+
+            std::mt19937 rng(5);
+            int fired=0;
+            int callbacks=0;
+            auto batch = TimeWheel::TimeWheel::make_batch([&](const std::vector<uint64_t>& keys){
+                ++callbacks;
+                fired+=static_cast<int>(keys.size());
+            });
+            uint32_t slack = mode==0 ? 0 : 50;
+            for(int i=0;i<timers;++i){
+                uint32_t delay = 100+rng()%200;
+                if(mode<2){
+                    wheel.add_timer(delay,[&](){ ++callbacks; ++fired; },slack);
+                }else{
+                    wheel.add_batch_timer(batch,delay,i,slack);
+                }
+            }
+            int wakeups=0;
+            while(fired<timers){
+                epoll_event events[1];
+                if(::epoll_wait(ep,events,1,-1)==1){
+                    ++wakeups;
+                    wheel.process();
+                }
+            }
+            std::cout<<names[mode]<<": "<<wakeups<<" wakeups, "<<callbacks<<" callbacks for "<<timers<<" timers"<<std::endl;
+            ::close(ep);
+        }
+    }
+#endif
+
+    // 连接空闲超时式的抖动：多个线程不停地加一个定时器再取消上一个，工作线程正常推进
+    void churn_benchmark(){
+        std::cout<<"=== TimeWheel Churn Benchmark ==="<<std::endl;
+        const int per_thread=500000;
+        for(int threads:{1,4}){
+            TimeWheel::TimeWheel wheel;
+            wheel.start();
+            std::vector<std::thread> workers;
+            auto begin = std::chrono::steady_clock::now();
+            for(int t=0;t<threads;++t){
+                workers.emplace_back([&wheel](){
+                    uint64_t last=0;
+                    for(int i=0;i<per_thread;++i){
+                        uint64_t id=wheel.add_timer(30000,[](){});
+                        if(last){
+                            wheel.cancel_timer(last);
+                        }
+                        last=id;
+                    }
+                    wheel.cancel_timer(last);
+                });
+            }
+            for(auto& w:workers){
+                w.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+            wheel.stop();
+            std::cout<<threads<<" threads: "<<threads*per_thread/seconds/1e6<<"M add+cancel per second"<<std::endl;
+        }
+    }
+
+    // 100 万个未到期任务：插入、取消 10%、推进到全部到期
+    void benchmark(){
+        std::cout<<"=== TimeWheel Benchmark ==="<<std::endl;
+        const int timers = 1000000;
+        const uint32_t max_delay_ms = 600000;
+        TimeWheel::TimeWheel wheel;
+        std::mt19937 rng(1);
+        uint64_t fired=0;
+        std::vector<uint64_t> ids;
+        ids.reserve(timers);
+
+        auto begin = std::chrono::steady_clock::now();
+        for(int i=0;i<timers;++i){
+            ids.push_back(wheel.add_timer(rng()%max_delay_ms,[&fired](){ ++fired; }));
+        }
+        auto added = std::chrono::steady_clock::now();
+        for(int i=0;i<timers;i+=10){
+            wheel.cancel_timer(ids[i]);
+        }
+        auto cancelled = std::chrono::steady_clock::now();
+        uint64_t ticks = max_delay_ms/10+1;
+        for(uint64_t i=0;i<ticks;++i){
+            wheel.step();
+        }
+        auto done = std::chrono::steady_clock::now();
+
+        auto ns=[](auto a,auto b){ return std::chrono::duration<double,std::nano>(b-a).count(); };
+        std::cout<<"add:    "<<ns(begin,added)/timers<<" ns per timer"<<std::endl;
+        std::cout<<"cancel: "<<ns(added,cancelled)/(timers/10)<<" ns per timer"<<std::endl;
+        std::cout<<"expire: "<<ns(cancelled,done)/ticks<<" ns per tick, "<<ns(cancelled,done)/fired<<" ns per fired timer"<<std::endl;
+        std::cout<<"fired "<<fired<<" (expect "<<timers-timers/10<<"), active "<<wheel.get_active_task_count()<<std::endl;
+    }
+}
+
+
 #endif //CLION_TEST_TIMEWHEEL_H
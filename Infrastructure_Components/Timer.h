@@ -5,19 +5,59 @@
 #include <chrono>
 #include <functional>
 #include <thread>
-#include <queue>
 #include <algorithm>
 #include <mutex>
 #include <vector>
 #include <condition_variable>
 #include <atomic>
+#include <iostream>
+#include <cstdint>
+#include <random>
+#include <memory>
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
+/*
+ *  基于最小堆的定时器，单独一个线程按到期时间执行任务
+ *  堆是带索引的 4 叉堆：任务存放在槽位表里，堆里只放 {到期时间, 槽位号}，槽位记录自己在堆中的位置，
+ *  所以按 id 取消和改期都是 O(log n)，直接从堆里删掉，不留墓碑。
+ *  id 由槽位号和槽位的代数组成，槽位复用后旧 id 自动失效
+ *
+ *  默认在定时器线程上直接执行回调；构造时传入 executor（比如投递到 ThreadPool）后，
+ *  定时器线程只负责按时把回调交给 executor，慢回调不会拖慢其他定时器：
+ *      Timer timer([&pool](Timer::Task task) { pool.post(std::move(task)); });
+ *  stop() 会等已经交给 executor 的回调执行完，回调里调用 stop() 时不等（否则等的是自己）。
+ *  executor 不接受任务时应当抛异常，收下却不执行会让 stop() 一直等；这种 executor 用 stop(false)，
+ *  不等的时候 Timer 要活到这些回调结束，析构仍然会等，所以也不能在回调里销毁 Timer
+ *  周期任务按固定频率排在 start + k * interval 的网格上，上一次还没执行完又到点时按 OverrunPolicy 处理
+ *
+ *  Linux 上也可以不启动定时器线程：把 fd() 注册进自己的 epoll，可读时调用 process_expired()。
+ *  timerfd 始终只定在堆顶的到期时间，和 socket 共用一个事件循环线程
+ *
+ *  大量相近的超时可以给一个 slack：到期时间向上对齐到 slack 的整数倍，同一窗口里的任务落在同一时刻，一次唤醒全部执行。
+ *  批量任务只带一个 key，同一批次里一起到期的 key 合成一次回调：
+ *      auto batch = Timer::make_batch([](const std::vector<uint64_t>& conns) { ... });
+ *      timer.add_batch_task(batch, std::chrono::seconds(30), conn_id, std::chrono::milliseconds(100));
+ */
 class Timer{
 public:
     using Clock = std::chrono::steady_clock;
     using TimePoint = Clock::time_point;
     using Duration = Clock::duration; // 存储时间间隔
     using Task = std::function<void()>;
+    using Executor = std::function<void(Task)>;
+    using BatchCallback = std::function<void(const std::vector<uint64_t>& keys)>;
+    using Batch = std::shared_ptr<BatchCallback>;
+
+    // 周期任务到点时上一次还没执行完（或者错过了若干个周期）
+    enum class OverrunPolicy{
+        Skip,     // 跳过错过的执行，等下一个周期
+        Coalesce  // 错过的若干次合并成一次，上一次结束后立刻补上
+    };
 
     struct TimerTask{
         TimePoint next_run; // 下次执行时间
@@ -30,17 +70,53 @@ public:
         }
     };
 private:
-    std::priority_queue<TimerTask,std::vector<TimerTask>,std::greater<TimerTask>> heap_;
+    static constexpr size_t ARITY = 4;
+    static constexpr size_t NOT_IN_HEAP = SIZE_MAX;
+
+    struct HeapEntry{
+        TimePoint when;
+        uint32_t slot;
+    };
+    struct Slot{
+        TimerTask timer;
+        size_t heap_pos = NOT_IN_HEAP;
+        uint32_t generation = 0;
+        bool in_use = false;
+        bool running = false;    // 正在执行：直接执行时已经不在堆里，交给 executor 的周期任务仍在堆里
+        bool cancelled = false;  // 执行期间被取消，执行完释放槽位
+        bool rescheduled = false;// 直接执行期间被改期，执行完按 timer.next_run 放回
+        bool pending = false;    // Coalesce：执行期间又到点了，结束后补一次
+        OverrunPolicy policy = OverrunPolicy::Coalesce;
+        std::shared_ptr<Task> shared; // 交给 executor 的周期任务，多次执行共用
+        Batch batch;                  // 批量任务所属的批次，timer.task 为空
+        uint64_t key = 0;
+    };
+
+    std::vector<HeapEntry> heap_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_slots_;
     mutable std::mutex mutex_;
     std::condition_variable cv_;
     std::atomic<bool> running_{false};
-    std::atomic<uint64_t> next_id_{1};
     std::thread worker_thread_;
+    Executor executor_;
+    size_t in_flight_ = 0;                 // 交给 executor 还没执行完的任务数
+    std::atomic<uint64_t> skipped_{0};
+    bool stopped_ = false;                 // stop() 之后 Coalesce 不再补执行
+#ifdef __linux__
+    int timer_fd_ = -1;
+#endif
 
 public:
     Timer() = default;
+    explicit Timer(Executor executor) : executor_(std::move(executor)) {}
     ~Timer(){
         stop();
+#ifdef __linux__
+        if(timer_fd_ >= 0){
+            ::close(timer_fd_);
+        }
+#endif
     }
 
     void start(){
@@ -48,35 +124,148 @@ public:
             //exchange读取running_的值，并将其设置为true，返回旧值，如果之前是false就不会进入if
             return;
         }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = false;
+        }
+        if(worker_thread_.joinable()){
+            worker_thread_.join(); // 上一次是在回调里 stop() 的，线程还没回收
+        }
         worker_thread_ = std::thread([this]{
             run();
         });
     }
 
-    // 添加一次性任务
-    uint64_t add_one_shot_task(Duration delay,Task task){
-        return add_task(delay,Duration::zero(),std::move(task));
+    // 添加一次性任务；slack 大于 0 时允许最多晚 slack 执行，和同一窗口里的任务合并成一次唤醒
+    uint64_t add_one_shot_task(Duration delay,Task task,Duration slack = Duration::zero()){
+        return add_task(delay,Duration::zero(),std::move(task),OverrunPolicy::Coalesce,slack);
+    }
+    static Batch make_batch(BatchCallback callback){
+        return std::make_shared<BatchCallback>(std::move(callback));
+    }
+    // 添加批量任务：同一个批次里一起到期的任务，回调只调一次，参数是它们的 key；返回的 id 照常可以取消、改期
+    uint64_t add_batch_task(const Batch& batch,Duration delay,uint64_t key,Duration slack = Duration::zero()){
+        return add_task(delay,Duration::zero(),nullptr,OverrunPolicy::Coalesce,slack,batch,key);
     }
     // 添加周期性任务
-    uint64_t add_fixed_rate_task(Duration inital_delay,Duration interval,Task task){
-        return add_task(inital_delay,interval,std::move(task));
+    uint64_t add_fixed_rate_task(Duration inital_delay,Duration interval,Task task,
+                                 OverrunPolicy policy = OverrunPolicy::Coalesce){
+        return add_task(inital_delay,interval,std::move(task),policy);
     }
+    // 取消任务；正在执行的周期任务这次执行完后不再调度。任务不存在、已结束或是正在执行的一次性任务（停不下来）返回 false
     bool cancel_task(uint64_t task_id){
-        // TODO
-        return false;
+        bool woke = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Slot* slot = find(task_id);
+            if(slot == nullptr || slot->cancelled){
+                return false;
+            }
+            // 一次性任务正在执行且没有改期：这次执行完就结束了，取消不会阻止任何事
+            if(slot->running && slot->timer.interval == Duration::zero() && !slot->rescheduled){
+                return false;
+            }
+            if(slot->heap_pos != NOT_IN_HEAP){
+                woke = slot->heap_pos == 0;
+                erase_at(slot->heap_pos);
+                if(woke){
+                    rearm();
+                }
+            }
+            if(slot->running){
+                slot->cancelled = true;
+            }
+            else{
+                release(static_cast<uint32_t>(slot - slots_.data()));
+            }
+        }
+        if(woke){
+            cv_.notify_one();
+        }
+        return true;
+    }
+    // 把任务的下次执行时间改为 delay 之后，周期不变
+    bool reschedule_task(uint64_t task_id,Duration delay){
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Slot* slot = find(task_id);
+            if(slot == nullptr || slot->cancelled){
+                return false;
+            }
+            slot->timer.next_run = Clock::now() + delay;
+            if(slot->heap_pos == NOT_IN_HEAP){
+                slot->rescheduled = true;
+                return true;
+            }
+            size_t pos = slot->heap_pos;
+            heap_[pos].when = slot->timer.next_run;
+            sift_down(sift_up(pos));
+            rearm();
+        }
+        cv_.notify_one();
+        return true;
+    }
+    // 等待执行的任务数
+    size_t pending_count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return heap_.size();
+    }
+
+    // 因为上一次还没执行完或定时器线程落后而没有执行的周期任务次数
+    uint64_t skipped_count() const {
+        return skipped_.load(std::memory_order_relaxed);
     }
 
-    void stop()
+    /*
+     *  停止定时器线程，wait 为 true 时等已经交给 executor 的任务执行完，之后它们不会再访问 Timer。
+     *  在本定时器的回调里调用时既不等也不 join（回调可能就在定时器线程上），线程留到下一次 stop()/start()/析构再回收
+     */
+    void stop(bool wait = true)
     {
-        if(!running_.exchange(false)){
-            return;
+        bool in_callback = current_timer() == this;
+        if(running_.exchange(false)){
+            cv_.notify_all();
         }
-        cv_.notify_all();
-        if(worker_thread_.joinable()){
+        if(!in_callback && worker_thread_.joinable()){
             worker_thread_.join();
         }
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopped_ = true;
+        if(wait && !in_callback){
+            cv_.wait(lock,[this](){ return in_flight_ == 0; });
+        }
     }
 
+#ifdef __linux__
+    // 给外部事件循环用的 timerfd，可读时调用 process_expired()；不要和 start() 同时用
+    int fd(){
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(timer_fd_ < 0){
+            timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+            if(timer_fd_ < 0){
+                throw std::runtime_error("Timer: timerfd_create failed");
+            }
+            rearm();
+        }
+        return timer_fd_;
+    }
+
+    // 执行所有已到期的任务，再把 timerfd 定到新的堆顶
+    void process_expired(){
+        uint64_t expirations;
+        ssize_t n = ::read(timer_fd_,&expirations,sizeof(expirations)); // 非阻塞，提前醒来时返回 EAGAIN
+        (void)n;
+        while(true){
+            std::unique_lock<std::mutex> lock(mutex_);
+            if(heap_.empty() || heap_[0].when > Clock::now()){
+                rearm();
+                return;
+            }
+            fire_top(lock);
+        }
+    }
+#endif
+
 private:
     void run()
     {
@@ -88,51 +277,378 @@ private:
                 });
                 continue; // continue的作用，重新校验状态
             }
-            const auto& top_task = heap_.top();
-            auto now = Clock::now();
-            if(top_task.next_run > now){
-                cv_.wait_until(lock,top_task.next_run);
+            // 复制时间点：等待期间堆可能被修改
+            TimePoint next_run = heap_[0].when;
+            if(next_run > Clock::now()){
+                cv_.wait_until(lock,next_run);
                 continue;
             }
-            auto task = heap_.top();
-            heap_.pop();
+            fire_top(lock);
+        }
+    }
+
+    // 堆顶已到期：交给 executor 或者直接执行；调用方持锁，返回时锁可能已经释放
+    void fire_top(std::unique_lock<std::mutex>& lock){
+        uint32_t index = heap_[0].slot;
+        if(slots_[index].batch){
+            fire_batches(lock);
+            return;
+        }
+        if(executor_){
+            dispatch(lock,index);
+            return;
+        }
+        erase_at(0);
+        slots_[index].running = true;
+        Task task = std::move(slots_[index].timer.task);
+        lock.unlock();
+        run_task(task);
+        lock.lock();
+        // 执行期间 slots_ 可能扩容，重新按下标取
+        Slot& slot = slots_[index];
+        slot.running = false;
+        bool again = !slot.cancelled && (slot.timer.interval > Duration::zero() || slot.rescheduled);
+        if(again){
+            if(!slot.rescheduled){
+                advance(slot,Clock::now());
+            }
+            slot.rescheduled = false;
+            slot.timer.task = std::move(task);
+            push(index);
+        }
+        else{
+            release(index);
+        }
+    }
+
+    /*
+     *  堆顶连续到期的批量任务一次取完，按批次归并 key，每个批次调一次回调；
+     *  批次一般只有几个，线性查找就够了。调用方持锁，执行前解锁
+     */
+    void fire_batches(std::unique_lock<std::mutex>& lock){
+        std::vector<std::pair<Batch,std::vector<uint64_t>>> due;
+        TimePoint now = Clock::now();
+        while(!heap_.empty() && heap_[0].when <= now && slots_[heap_[0].slot].batch){
+            uint32_t index = heap_[0].slot;
+            Slot& slot = slots_[index];
+            erase_at(0);
+            auto it = std::find_if(due.begin(), due.end(), [&slot](const auto& d){ return d.first == slot.batch; });
+            if(it == due.end()){
+                due.emplace_back(slot.batch, std::vector<uint64_t>());
+                it = due.end() - 1;
+            }
+            it->second.push_back(slot.key);
+            release(index);
+        }
+        if(executor_){
+            in_flight_ += due.size();
+        }
+        lock.unlock();
+        for(auto& d : due){
+            if(!executor_){
+                run_task([&d](){ (*d.first)(d.second); });
+                continue;
+            }
+            auto batch = std::make_shared<std::pair<Batch,std::vector<uint64_t>>>(std::move(d));
+            submit([this,batch](){
+                run_task([&batch](){ (*batch->first)(batch->second); });
+                std::lock_guard<std::mutex> guard(mutex_);
+                finish_one();
+            });
+        }
+    }
+
+#ifdef __linux__
+    // 调用方持锁：timerfd 定到堆顶的绝对时间，堆空就停掉
+    void rearm(){
+        if(timer_fd_ < 0){
+            return;
+        }
+        itimerspec spec{};
+        if(!heap_.empty()){
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(heap_[0].when.time_since_epoch()).count();
+            spec.it_value.tv_sec = ns / 1000000000;
+            spec.it_value.tv_nsec = ns % 1000000000;
+            if(ns <= 0){
+                spec.it_value.tv_sec = 0;
+                spec.it_value.tv_nsec = 1; // 全 0 会被当成停掉
+            }
+        }
+        ::timerfd_settime(timer_fd_,TFD_TIMER_ABSTIME,&spec,nullptr);
+    }
+#else
+    void rearm(){}
+#endif
+
+    // 当前线程正在执行哪个定时器的回调，stop() 靠它判断是不是在等自己
+    static const Timer*& current_timer(){
+        static thread_local const Timer* timer = nullptr;
+        return timer;
+    }
+
+    void run_task(const Task& task) const {
+        const Timer* outer = current_timer();
+        current_timer() = this;
+        try{
+            task();
+        }
+        catch(const std::exception& e){
+            std::cerr<<"Timer task exception : "<<e.what()<<std::endl;
+        }
+        catch(...){
+            std::cerr<<"Timer task exception : unknown"<<std::endl;
+        }
+        current_timer() = outer;
+    }
+
+    // 固定频率：下次执行时间落在网格上。错过的周期按策略处理：Coalesce 合并成一次立刻执行，Skip 全部跳过
+    void advance(Slot& slot,TimePoint now){
+        Duration interval = slot.timer.interval;
+        TimePoint next = slot.timer.next_run + interval;
+        if(next <= now){
+            auto missed = (now - next) / interval + 1;   // 网格上已经过去的点数
+            if(slot.policy == OverrunPolicy::Coalesce){
+                next += (missed - 1) * interval;
+                skipped_.fetch_add(missed - 1,std::memory_order_relaxed);
+            }
+            else{
+                next += missed * interval;
+                skipped_.fetch_add(missed,std::memory_order_relaxed);
+            }
+        }
+        slot.timer.next_run = next;
+    }
+
+    /*
+     *  堆顶到期，交给 executor；调用方持锁，执行 executor 前解锁。
+     *  一次性任务直接释放槽位；周期任务先按网格排好下一次，上一次还在执行就按策略跳过或记下补一次
+     */
+    void dispatch(std::unique_lock<std::mutex>& lock,uint32_t index){
+        Slot& slot = slots_[index];
+        if(slot.timer.interval == Duration::zero()){
+            erase_at(0);
+            auto task = std::make_shared<Task>(std::move(slot.timer.task));
+            release(index);
+            in_flight_++;
             lock.unlock();
-            try{
-                task.task();
-            }
-            catch(...){
-                // TODO
-            }
-            if(task.interval > Duration::zero()){
-                lock.lock();
-                TimerTask new_task{
-                    Clock::now() + task.interval,
-                    task.interval,
-                    std::move(task.task),
-                    task.id
-                };
-                heap_.push(std::move(new_task));
-                cv_.notify_one();
-            }
-        }
-    }
-
-    uint64_t add_task(Duration delay,Duration interval,Task task){
-        auto id=next_id_.fetch_add(1);
-        auto now = Clock::now();
-        TimerTask timer_task{
-            now+delay,
-            interval,
-            std::move(task),
-            id
-        };
+            submit([this,task](){
+                run_task(*task);
+                std::lock_guard<std::mutex> guard(mutex_);
+                finish_one();
+            });
+            return;
+        }
+        bool busy = slot.running;
+        slot.timer.next_run = heap_[0].when;
+        advance(slot,Clock::now());
+        heap_[0].when = slot.timer.next_run;
+        sift_down(0);
+        if(busy){
+            if(slot.policy == OverrunPolicy::Coalesce){
+                slot.pending = true;
+            }
+            else{
+                skipped_.fetch_add(1,std::memory_order_relaxed);
+            }
+            return;
+        }
+        start_periodic(lock,index);
+    }
+
+    // 调用方持锁，执行 executor 前解锁
+    void start_periodic(std::unique_lock<std::mutex>& lock,uint32_t index){
+        Slot& slot = slots_[index];
+        if(!slot.shared){
+            slot.shared = std::make_shared<Task>(std::move(slot.timer.task));
+        }
+        slot.running = true;
+        in_flight_++;
+        auto task = slot.shared;
+        lock.unlock();
+        submit([this,task,index](){
+            run_task(*task);
+            finish_periodic(index);
+        },index);
+    }
+
+    // 周期任务的一次执行结束：被取消了就释放槽位，执行期间又到点过就马上补一次
+    void finish_periodic(uint32_t index){
+        std::unique_lock<std::mutex> lock(mutex_);
+        Slot& slot = slots_[index];
+        slot.running = false;
+        if(slot.cancelled){
+            release(index);
+        }
+        else if(slot.pending && !stopped_){
+            slot.pending = false;
+            in_flight_--;
+            start_periodic(lock,index);
+            return;
+        }
+        slot.pending = false;
+        finish_one();
+    }
+
+    // 调用方持锁
+    void finish_one(){
+        if(--in_flight_ == 0){
+            cv_.notify_all();
+        }
+    }
+
+    // executor 抛异常（比如线程池已经停止）时这次执行丢弃，状态要退回去；index 是周期任务的槽位
+    template<typename F>
+    void submit(F&& fn,uint32_t index = UINT32_MAX){
+        try{
+            executor_(Task(std::forward<F>(fn)));
+        }
+        catch(const std::exception& e){
+            std::cerr<<"Timer executor exception : "<<e.what()<<std::endl;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(index != UINT32_MAX){
+                slots_[index].running = false;
+                slots_[index].pending = false;
+                if(slots_[index].cancelled){
+                    release(index);
+                }
+            }
+            finish_one();
+        }
+    }
+
+    // 向上对齐到 slack 的整数倍（从时钟纪元算），同一窗口里的任务到期时间完全相同
+    static TimePoint align_up(TimePoint when,Duration slack){
+        if(slack <= Duration::zero()){
+            return when;
+        }
+        Duration rem = when.time_since_epoch() % slack;
+        return rem == Duration::zero() ? when : when + (slack - rem);
+    }
+
+    uint64_t add_task(Duration delay,Duration interval,Task task,OverrunPolicy policy = OverrunPolicy::Coalesce,
+                      Duration slack = Duration::zero(),const Batch& batch = nullptr,uint64_t key = 0){
+        uint64_t id;
+        bool woke;
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            heap_.push(std::move(timer_task));
+            uint32_t index;
+            if(free_slots_.empty()){
+                index = static_cast<uint32_t>(slots_.size());
+                slots_.emplace_back();
+            }
+            else{
+                index = free_slots_.back();
+                free_slots_.pop_back();
+            }
+            Slot& slot = slots_[index];
+            id = uint64_t(slot.generation) << 32 | (uint64_t(index) + 1);
+            slot.timer = TimerTask{align_up(Clock::now() + delay, slack), interval, std::move(task), id};
+            slot.policy = policy;
+            slot.batch = batch;
+            slot.key = key;
+            slot.in_use = true;
+            push(index);
+            woke = slot.heap_pos == 0;
+            if(woke){
+                rearm();
+            }
+        }
+        // 只有新任务成了堆顶才需要叫醒工作线程
+        if(woke){
+            cv_.notify_one();
         }
-        cv_.notify_one();
         return id;
     }
+
+    // 调用方持锁
+    Slot* find(uint64_t task_id){
+        uint64_t index = (task_id & 0xffffffffu);
+        if(index == 0 || index > slots_.size()){
+            return nullptr;
+        }
+        Slot& slot = slots_[index - 1];
+        if(!slot.in_use || slot.generation != (task_id >> 32)){
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    void release(uint32_t index){
+        Slot& slot = slots_[index];
+        slot.timer.task = nullptr;
+        slot.in_use = false;
+        slot.shared.reset();
+        slot.batch.reset();
+        slot.cancelled = false;
+        slot.rescheduled = false;
+        slot.pending = false;
+        slot.heap_pos = NOT_IN_HEAP;
+        slot.generation++;
+        free_slots_.push_back(index);
+    }
+
+    void push(uint32_t index){
+        heap_.push_back(HeapEntry{slots_[index].timer.next_run, index});
+        slots_[index].heap_pos = heap_.size() - 1;
+        sift_up(heap_.size() - 1);
+    }
+
+    // 用最后一个元素填补 pos，再向上或向下调整
+    void erase_at(size_t pos){
+        slots_[heap_[pos].slot].heap_pos = NOT_IN_HEAP;
+        if(pos + 1 != heap_.size()){
+            place(pos, heap_.back());
+            heap_.pop_back();
+            sift_down(sift_up(pos));
+        }
+        else{
+            heap_.pop_back();
+        }
+    }
+
+    void place(size_t pos, const HeapEntry& entry){
+        heap_[pos] = entry;
+        slots_[entry.slot].heap_pos = pos;
+    }
+
+    size_t sift_up(size_t pos){
+        HeapEntry entry = heap_[pos];
+        while(pos > 0){
+            size_t parent = (pos - 1) / ARITY;
+            if(!(entry.when < heap_[parent].when)){
+                break;
+            }
+            place(pos, heap_[parent]);
+            pos = parent;
+        }
+        place(pos, entry);
+        return pos;
+    }
+
+    size_t sift_down(size_t pos){
+        HeapEntry entry = heap_[pos];
+        size_t n = heap_.size();
+        while(true){
+            size_t first = pos * ARITY + 1;
+            if(first >= n){
+                break;
+            }
+            size_t best = first;
+            size_t last = std::min(first + ARITY, n);
+            for(size_t c = first + 1; c < last; c++){
+                if(heap_[c].when < heap_[best].when){
+                    best = c;
+                }
+            }
+            if(!(heap_[best].when < entry.when)){
+                break;
+            }
+            place(pos, heap_[best]);
+            pos = best;
+        }
+        place(pos, entry);
+        return pos;
+    }
 };
 
 namespace Timer_Test{
@@ -144,14 +660,241 @@ namespace Timer_Test{
             std::cout<<"One shot task executed after 2 seconds"<<std::endl;
         });
 
-        timer.add_fixed_rate_task(std::chrono::seconds(1),std::chrono::seconds(3),[]{
+        uint64_t periodic = timer.add_fixed_rate_task(std::chrono::seconds(1),std::chrono::seconds(3),[]{
             static int count =0;
             std::cout<<"Fixed rate task executed "<<++count<<" times"<<std::endl;
         });
 
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+        uint64_t never = timer.add_one_shot_task(std::chrono::seconds(1),[]{
+            std::cout<<"cancelled task should not run"<<std::endl;
+        });
+        std::cout<<"cancel one shot: "<<timer.cancel_task(never)<<" (expect 1), again: "<<timer.cancel_task(never)<<" (expect 0)"<<std::endl;
+
+        // 一次性任务已经在执行时取消不了，返回 false
+        std::atomic<uint64_t> self{0};
+        std::atomic<int> self_cancel{-1};
+        self = timer.add_one_shot_task(std::chrono::milliseconds(100),[&timer,&self,&self_cancel]{
+            self_cancel = timer.cancel_task(self.load());
+        });
+
+        // 周期任务执行 3 次后取消，之后不再执行，堆里也不留下它
+        std::this_thread::sleep_for(std::chrono::seconds(8));
+        std::cout<<"cancel running one shot: "<<self_cancel.load()<<" (expect 0)"<<std::endl;
+        std::cout<<"cancel periodic: "<<timer.cancel_task(periodic)<<" (expect 1)"<<std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(4));
+        std::cout<<"pending after cancel: "<<timer.pending_count()<<" (expect 0)"<<std::endl;
         timer.stop();
     }
+
+    /*
+     *  一个 250ms 的慢周期任务（周期 100ms）和一个 50ms 周期的快任务放在一起，跑 1 秒：
+     *  直接执行时快任务被慢任务拖住，两次执行间隔被拉长；交给 executor 后间隔保持 50ms 左右；
+     *  慢任务在 Skip 下只执行能赶上的次数，在 Coalesce 下每次结束后补一次
+     */
+    void executor_test(){
+        std::cout<<"=== Timer Executor Test ==="<<std::endl;
+        // 简单的 executor：每个任务一个线程，最后统一 join
+        std::mutex threads_mutex;
+        std::vector<std::thread> threads;
+        Timer::Executor spawn = [&](Timer::Task task){
+            std::lock_guard<std::mutex> lock(threads_mutex);
+            threads.emplace_back(std::move(task));
+        };
+
+        auto trial = [&](const char* name, Timer::Executor executor, Timer::OverrunPolicy policy){
+            Timer timer(std::move(executor));
+            std::atomic<int> slow_runs{0};
+            // 快任务同一时刻只在一个线程上执行，这两个变量不需要原子
+            int64_t worst_gap_us = 0;
+            Timer::TimePoint last_fast{};
+            const auto fast_interval = std::chrono::milliseconds(50);
+            timer.add_fixed_rate_task(std::chrono::milliseconds(100), std::chrono::milliseconds(100), [&](){
+                slow_runs++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            }, policy);
+            timer.add_fixed_rate_task(fast_interval, fast_interval, [&](){
+                auto now = Timer::Clock::now();
+                if(last_fast != Timer::TimePoint{}){
+                    worst_gap_us = std::max<int64_t>(worst_gap_us,
+                            std::chrono::duration_cast<std::chrono::microseconds>(now - last_fast).count());
+                }
+                last_fast = now;
+            });
+            timer.start();
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            timer.stop();
+            std::cout<<name<<": slow runs "<<slow_runs.load()<<", skipped "<<timer.skipped_count()
+                     <<", fast task worst gap "<<worst_gap_us / 1000.0<<"ms"<<std::endl;
+        };
+        trial("inline", nullptr, Timer::OverrunPolicy::Coalesce);
+        trial("executor + skip", spawn, Timer::OverrunPolicy::Skip);
+        trial("executor + coalesce", spawn, Timer::OverrunPolicy::Coalesce);
+        for(auto& t : threads){
+            t.join();
+        }
+
+        // 回调里 stop()：直接执行和交给 executor 两种情况都不能等自己
+        for(bool use_executor : {false, true}){
+            threads.clear();
+            Timer timer(use_executor ? spawn : Timer::Executor());
+            std::atomic<bool> stopped{false};
+            timer.add_one_shot_task(std::chrono::milliseconds(10), [&](){
+                timer.stop();
+                stopped = true;
+            });
+            timer.start();
+            while(!stopped){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            timer.stop(); // 回收定时器线程，之后不会再往 threads 里加
+            for(auto& t : threads){
+                t.join();
+            }
+            std::cout<<(use_executor ? "executor" : "inline")<<": stop() inside callback returned"<<std::endl;
+        }
+
+        // executor 先攒着任务：stop(false) 立刻返回，之后再执行，析构前跑完
+        std::vector<Timer::Task> held;
+        std::mutex held_mutex;
+        {
+            Timer timer([&](Timer::Task task){
+                std::lock_guard<std::mutex> lock(held_mutex);
+                held.push_back(std::move(task));
+            });
+            std::atomic<int> runs{0};
+            timer.add_one_shot_task(std::chrono::milliseconds(10), [&runs](){ runs++; });
+            timer.start();
+            while(true){
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                std::lock_guard<std::mutex> lock(held_mutex);
+                if(!held.empty()){
+                    break;
+                }
+            }
+            timer.stop(false);
+            std::cout<<"stop(false) returned with "<<held.size()<<" task held, runs "<<runs.load()<<" (expect 0)"<<std::endl;
+            for(auto& task : held){
+                task();
+            }
+            std::cout<<"held task ran: "<<runs.load()<<" (expect 1)"<<std::endl;
+        }
+    }
+
+#ifdef __linux__
+    // 不启动定时器线程，由 epoll 循环驱动：一次性任务、周期任务、改期都只在到期时醒
+    void epoll_test(){
+        std::cout<<"=== Timer epoll Test ==="<<std::endl;
+        Timer timer;
+        int ep = ::epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = timer.fd();
+        ::epoll_ctl(ep, EPOLL_CTL_ADD, ev.data.fd, &ev);
+
+        auto begin = Timer::Clock::now();
+        auto elapsed_ms = [&begin](){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(Timer::Clock::now() - begin).count();
+        };
+        int periodic_runs = 0;
+        bool done = false;
+        timer.add_fixed_rate_task(std::chrono::milliseconds(100), std::chrono::milliseconds(100), [&](){
+            periodic_runs++;
+        });
+        uint64_t late = timer.add_one_shot_task(std::chrono::seconds(10), [&](){
+            std::cout<<"rescheduled task fired at "<<elapsed_ms()<<"ms (expect ~250)"<<std::endl;
+        });
+        timer.reschedule_task(late, std::chrono::milliseconds(250));
+        timer.add_one_shot_task(std::chrono::milliseconds(520), [&](){ done = true; });
+
+        int wakeups = 0;
+        while(!done){
+            epoll_event events[1];
+            if(::epoll_wait(ep, events, 1, -1) == 1){
+                wakeups++;
+                timer.process_expired();
+            }
+        }
+        std::cout<<"periodic runs: "<<periodic_runs<<" (expect 5), wakeups: "<<wakeups<<" (expect ~7)"<<std::endl;
+        ::close(ep);
+    }
+
+    // 1 万个 100~300ms 的超时：不带 slack、带 50ms slack、带 slack 的批量任务，比较 epoll 唤醒次数和回调次数
+    void coalesce_test(){
+        std::cout<<"=== Timer Coalesce Test ==="<<std::endl;
+        const int timers = 10000;
+        for(int mode = 0; mode < 3; mode++){
+            Timer timer;
+            int ep = ::epoll_create1(EPOLL_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = timer.fd();
+            ::epoll_ctl(ep, EPOLL_CTL_ADD, ev.data.fd, &ev);
+
+            std::mt19937 rng(5);
+            int fired = 0;
+            int callbacks = 0;
+            auto batch = Timer::make_batch([&](const std::vector<uint64_t>& keys){
+                callbacks++;
+                fired += static_cast<int>(keys.size());
+            });
+            auto slack = mode == 0 ? Timer::Duration::zero() : Timer::Duration(std::chrono::milliseconds(50));
+            for(int i = 0; i < timers; i++){
+                auto delay = std::chrono::milliseconds(100 + rng() % 200);
+                if(mode < 2){
+                    timer.add_one_shot_task(delay, [&](){ callbacks++; fired++; }, slack);
+                }
+                else{
+                    timer.add_batch_task(batch, delay, i, slack);
+                }
+            }
+            int wakeups = 0;
+            while(fired < timers){
+                epoll_event events[1];
+                if(::epoll_wait(ep, events, 1, -1) == 1){
+                    wakeups++;
+                    timer.process_expired();
+                }
+            }
+            const char* names[] = {"no slack", "50ms slack", "50ms slack + batch"};
+            std::cout<<names[mode]<<": "<<wakeups<<" wakeups, "<<callbacks<<" callbacks for "<<timers<<" timers"<<std::endl;
+            ::close(ep);
+        }
+    }
+#endif
+
+    // 100 万个未到期定时器上的调度/取消/改期抖动，定时器线程不启动，只测堆操作
+    void benchmark(){
+        std::cout<<"=== Timer Benchmark ==="<<std::endl;
+        const int timers = 1000000;
+        Timer timer;
+        std::mt19937 rng(3);
+        std::vector<uint64_t> ids;
+        ids.reserve(timers);
+        auto delay = [&rng](){ return std::chrono::seconds(60) + std::chrono::milliseconds(rng() % 3600000); };
+
+        auto begin = Timer::Clock::now();
+        for(int i = 0; i < timers; i++){
+            ids.push_back(timer.add_one_shot_task(delay(), []{}));
+        }
+        auto scheduled = Timer::Clock::now();
+        // 抖动：随机取消一个再补一个
+        for(int i = 0; i < timers; i++){
+            size_t k = rng() % ids.size();
+            timer.cancel_task(ids[k]);
+            ids[k] = timer.add_one_shot_task(delay(), []{});
+        }
+        auto churned = Timer::Clock::now();
+        for(int i = 0; i < timers; i++){
+            timer.reschedule_task(ids[rng() % ids.size()], delay());
+        }
+        auto rescheduled = Timer::Clock::now();
+
+        auto ns = [](auto a, auto b){ return std::chrono::duration<double, std::nano>(b - a).count(); };
+        std::cout<<"schedule:        "<<ns(begin, scheduled) / timers<<" ns"<<std::endl;
+        std::cout<<"cancel+schedule: "<<ns(scheduled, churned) / timers<<" ns"<<std::endl;
+        std::cout<<"reschedule:      "<<ns(churned, rescheduled) / timers<<" ns"<<std::endl;
+        std::cout<<"pending: "<<timer.pending_count()<<" (expect "<<timers<<", no tombstones)"<<std::endl;
+    }
 };
 
 #endif //CPP_LEARN_TIMER_H
\ No newline at end of file